@@ -0,0 +1,348 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "BVH.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+/// the input of BVH::build(), shared by all threads
+struct BVH::BuildInput
+{
+    /// bounding boxes of the primitives
+    const std::vector<vec3>& bb_min;
+    const std::vector<vec3>& bb_max;
+    /// centers of the bounding boxes
+    std::vector<vec3> centroids;
+    /// maximum number of primitives of a leaf
+    int max_leaf_size;
+    /// split algorithm
+    Method method;
+};
+
+
+/// The traversal stacks hold 64 nodes, which limits the depth of the tree.
+/// Deeper than this, nodes are split at the median, which halves them.
+static const int max_sah_depth = 32;
+
+/// Subtrees of at least this many primitives are built by their own thread.
+static const int parallel_threshold = 4096;
+
+/// Number of bins per axis of the surface area heuristic.
+static const int num_bins = 16;
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Largest float not larger than \c _x
+static float round_down(double _x)
+{
+    const float f = float(_x);
+    return (f > _x) ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+}
+
+/// Smallest float not smaller than \c _x
+static float round_up(double _x)
+{
+    const float f = float(_x);
+    return (f < _x) ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+}
+
+/// Half the surface area of the box [\c _bb_min, \c _bb_max]
+static double half_area(const vec3& _bb_min, const vec3& _bb_max)
+{
+    const vec3 e = _bb_max - _bb_min;
+    return e[0]*e[1] + e[1]*e[2] + e[2]*e[0];
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void BVH::build(const std::vector<vec3>& _bb_min,
+                const std::vector<vec3>& _bb_max,
+                int _max_leaf_size,
+                Method _method)
+{
+    static_assert(sizeof(Node) == 32, "BVH nodes should take 32 bytes");
+
+    nodes_.clear();
+    indices_.clear();
+
+    const int n = int(_bb_min.size());
+    if (n == 0) return;
+
+    // the leaf size has to fit into Node::count
+    BuildInput input{_bb_min, _bb_max, std::vector<vec3>(n),
+                     std::min(std::max(_max_leaf_size, 1), 0xffff), _method};
+    indices_.resize(n);
+    for (int i = 0; i < n; ++i)
+    {
+        input.centroids[i] = 0.5 * (_bb_min[i] + _bb_max[i]);
+        indices_[i]        = i;
+    }
+
+    const int threads = (n >= parallel_threshold) ? int(std::max(1u, std::thread::hardware_concurrency())) : 1;
+    nodes_.reserve(2 * n / input.max_leaf_size + 1);
+    build_recursive(input, 0, n, 0, threads, nodes_);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void BVH::build_recursive(const BuildInput& _input, int _begin, int _end, int _depth,
+                          int _threads, std::vector<Node>& _nodes)
+{
+    const int node_index = int(_nodes.size());
+    _nodes.emplace_back();
+
+    // bounding box of all primitives and of their centroids
+    vec3 bb_min(std::numeric_limits<double>::max());
+    vec3 bb_max(std::numeric_limits<double>::lowest());
+    vec3 c_min = bb_min, c_max = bb_max;
+    for (int i = _begin; i < _end; ++i)
+    {
+        const int j = indices_[i];
+        bb_min = min(bb_min, _input.bb_min[j]);
+        bb_max = max(bb_max, _input.bb_max[j]);
+        c_min  = min(c_min, _input.centroids[j]);
+        c_max  = max(c_max, _input.centroids[j]);
+    }
+
+    // enlarge the box slightly, such that rounding errors in the slab test
+    // never cull a primitive that the exact primitive test would hit, and
+    // round it outwards to single precision
+    const vec3 eps = 1e-9 * (bb_max - bb_min) + vec3(1e-12);
+    for (int c = 0; c < 3; ++c)
+    {
+        _nodes[node_index].bb_min[c] = round_down(bb_min[c] - eps[c]);
+        _nodes[node_index].bb_max[c] = round_up  (bb_max[c] + eps[c]);
+    }
+
+    if (_end - _begin <= _input.max_leaf_size)
+    {
+        _nodes[node_index].offset = _begin;
+        _nodes[node_index].count  = _end - _begin;
+        _nodes[node_index].axis   = 0;
+        return;
+    }
+
+    int axis = 0;
+    int mid  = -1;
+    if (_input.method == SAH && _depth < max_sah_depth)
+        mid = split_sah(_input, _begin, _end, c_min, c_max, axis);
+
+    // object median split along the longest axis of the centroid box, also
+    // if the surface area heuristic finds no split
+    if (mid < 0)
+    {
+        const vec3 extent = c_max - c_min;
+        axis = 0;
+        if (extent[1] > extent[axis]) axis = 1;
+        if (extent[2] > extent[axis]) axis = 2;
+
+        mid = (_begin + _end) / 2;
+        std::nth_element(indices_.begin() + _begin,
+                         indices_.begin() + mid,
+                         indices_.begin() + _end,
+                         [&](int a, int b) { return _input.centroids[a][axis] < _input.centroids[b][axis]; });
+    }
+
+    _nodes[node_index].count = 0;
+    _nodes[node_index].axis  = axis;
+
+    // build the second child by another thread if both are large enough to
+    // be worth it, then append its nodes behind the ones of the first child
+    if (_threads > 1 && std::min(mid - _begin, _end - mid) >= parallel_threshold)
+    {
+        std::vector<Node> second;
+        second.reserve(2 * (_end - mid) / _input.max_leaf_size + 1);
+        std::thread thread([&]()
+        {
+            build_recursive(_input, mid, _end, _depth + 1, _threads / 2, second);
+        });
+        build_recursive(_input, _begin, mid, _depth + 1, _threads - _threads / 2, _nodes);
+        thread.join();
+
+        const int offset = int(_nodes.size());
+        for (Node& node: second)
+            if (!node.count) node.offset += offset;
+        _nodes.insert(_nodes.end(), second.begin(), second.end());
+        _nodes[node_index].offset = offset;
+    }
+    else
+    {
+        build_recursive(_input, _begin, mid, _depth + 1, _threads, _nodes);
+        _nodes[node_index].offset = int(_nodes.size());
+        build_recursive(_input, mid, _end, _depth + 1, _threads, _nodes);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+int BVH::split_sah(const BuildInput& _input, int _begin, int _end,
+                   const vec3& _c_min, const vec3& _c_max, int& _axis)
+{
+    struct Bin
+    {
+        vec3 bb_min = vec3(std::numeric_limits<double>::max());
+        vec3 bb_max = vec3(std::numeric_limits<double>::lowest());
+        int  count  = 0;
+    };
+
+    // bin of the centroid of primitive j along an axis
+    auto bin_index = [&](int _j, int _a, double _scale)
+    {
+        const int b = int((_input.centroids[_j][_a] - _c_min[_a]) * _scale);
+        return std::min(b, num_bins - 1);
+    };
+
+    // find the split between two bins with the smallest sum of the areas of
+    // the children weighted by their number of primitives
+    double best_cost  = std::numeric_limits<double>::infinity();
+    int    best_split = -1;
+    for (int a = 0; a < 3; ++a)
+    {
+        const double extent = _c_max[a] - _c_min[a];
+        if (!(extent > 0.0)) continue;
+        const double scale = num_bins / extent;
+
+        Bin bins[num_bins];
+        for (int i = _begin; i < _end; ++i)
+        {
+            const int j = indices_[i];
+            Bin& bin = bins[bin_index(j, a, scale)];
+            bin.bb_min = min(bin.bb_min, _input.bb_min[j]);
+            bin.bb_max = max(bin.bb_max, _input.bb_max[j]);
+            ++bin.count;
+        }
+
+        // cost of the right child of the splits before bins 1, ..., num_bins-1
+        double right_cost[num_bins];
+        Bin    right;
+        for (int b = num_bins - 1; b > 0; --b)
+        {
+            right.bb_min = min(right.bb_min, bins[b].bb_min);
+            right.bb_max = max(right.bb_max, bins[b].bb_max);
+            right.count += bins[b].count;
+            right_cost[b] = right.count ? right.count * half_area(right.bb_min, right.bb_max) : 0.0;
+        }
+
+        Bin left;
+        for (int b = 1; b < num_bins; ++b)
+        {
+            left.bb_min = min(left.bb_min, bins[b-1].bb_min);
+            left.bb_max = max(left.bb_max, bins[b-1].bb_max);
+            left.count += bins[b-1].count;
+            if (left.count == 0 || left.count == _end - _begin) continue;
+
+            const double cost = left.count * half_area(left.bb_min, left.bb_max) + right_cost[b];
+            if (cost < best_cost)
+            {
+                best_cost  = cost;
+                best_split = b;
+                _axis      = a;
+            }
+        }
+    }
+
+    if (best_split < 0) return -1;
+
+    const double scale = num_bins / (_c_max[_axis] - _c_min[_axis]);
+    auto mid = std::partition(indices_.begin() + _begin, indices_.begin() + _end,
+                              [&](int j) { return bin_index(j, _axis, scale) < best_split; });
+    return int(mid - indices_.begin());
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void BVH::serialize(std::vector<char>& _buffer) const
+{
+    const unsigned int       node_size   = sizeof(Node);
+    const unsigned long long num_nodes   = nodes_.size();
+    const unsigned long long num_indices = indices_.size();
+    write_binary(_buffer, &node_size);
+    write_binary(_buffer, &num_nodes);
+    write_binary(_buffer, &num_indices);
+    write_binary(_buffer, nodes_.data(), nodes_.size());
+    write_binary(_buffer, indices_.data(), indices_.size());
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool BVH::deserialize(const char*& _data, const char* _end)
+{
+    unsigned int       node_size;
+    unsigned long long num_nodes, num_indices;
+    if (!read_binary(_data, _end, &node_size) ||
+        node_size != sizeof(Node) ||
+        !read_binary(_data, _end, &num_nodes) ||
+        !read_binary(_data, _end, &num_indices) ||
+        num_nodes   > size_t(_end - _data) / sizeof(Node) ||
+        num_indices > size_t(_end - _data) / sizeof(int))
+        return false;
+
+    nodes_.resize(num_nodes);
+    indices_.resize(num_indices);
+    if (!read_binary(_data, _end, nodes_.data(), nodes_.size()) ||
+        !read_binary(_data, _end, indices_.data(), indices_.size()))
+    {
+        nodes_.clear();
+        indices_.clear();
+        return false;
+    }
+
+    // reject references outside of the arrays, and children that do not
+    // follow their parent, which would form a cycle (the nodes are stored
+    // depth-first)
+    for (int i = 0; i < int(num_nodes); ++i)
+    {
+        const Node& node = nodes_[i];
+        if (node.axis > 2 ||
+            (node.count ? (node.offset < 0 || node.offset + node.count > int(num_indices))
+                        : (node.offset <= i || node.offset >= int(num_nodes) ||
+                           i + 1 >= int(num_nodes))))
+        {
+            nodes_.clear();
+            indices_.clear();
+            return false;
+        }
+    }
+    for (int i: indices_)
+    {
+        if (i < 0 || i >= int(num_indices))
+        {
+            nodes_.clear();
+            indices_.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+
+//=============================================================================
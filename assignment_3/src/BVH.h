@@ -0,0 +1,284 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef BVH_H
+#define BVH_H
+
+
+//== INCLUDES =================================================================
+
+#include "Ray.h"
+#include "RayPacket.h"
+#include "Statistics.h"
+#include "vec3.h"
+
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class BVH BVH.h
+/// This class implements a bounding volume hierarchy over a set of primitives
+/// that are given by their axis-aligned bounding boxes. The hierarchy only
+/// stores primitive indices; the actual intersection test is done by the
+/// caller in the leaf callback passed to BVH::traverse(). The nodes are stored
+/// in depth-first order, i.e., the first child of an inner node directly
+/// follows its parent in the node array. A node takes 32 bytes, with its box
+/// stored in single precision (rounded outwards).
+class BVH
+{
+public:
+
+    /// Algorithm used by build() to split a node
+    enum Method
+    {
+        /// object median along the longest axis of the centroid box: fast
+        /// to build, slower to traverse
+        MEDIAN,
+        /// binned surface area heuristic: slower to build, faster to traverse
+        SAH
+    };
+
+    /// Build the hierarchy for the primitives with bounding boxes
+    /// (\c _bb_min[i], \c _bb_max[i]). Leaves hold at most
+    /// \c _max_leaf_size primitives. Subtrees of many primitives are built
+    /// in parallel.
+    void build(const std::vector<vec3>& _bb_min,
+               const std::vector<vec3>& _bb_max,
+               int _max_leaf_size = 4,
+               Method _method = SAH);
+
+    /// Identifies the algorithms of build(). Incremented whenever build()
+    /// produces different hierarchies for the same input, such that stored
+    /// hierarchies (see Mesh::read_cache()) are rebuilt.
+    static const unsigned int builder_version = 2;
+
+    /// Append the hierarchy in binary form to \c _buffer.
+    void serialize(std::vector<char>& _buffer) const;
+
+    /// Restore the hierarchy from binary data written by serialize(),
+    /// starting at \c _data, which is advanced past the hierarchy. Returns
+    /// false if the data before \c _end is incomplete or inconsistent, or
+    /// if it was written with a different node layout.
+    bool deserialize(const char*& _data, const char* _end);
+
+    /// Does the hierarchy contain any primitives?
+    bool empty() const { return nodes_.empty(); }
+
+    /// Number of primitives stored in the hierarchy.
+    int size() const { return int(indices_.size()); }
+
+    /// Index of the primitive at position \c _position of the leaf order.
+    /// The primitives of every leaf occupy a contiguous range of positions.
+    int primitive(int _position) const { return indices_[_position]; }
+
+    /// Traverse all leaves whose bounding box is hit by \c _ray in the
+    /// parameter interval [0, \c _tmax]. For each such leaf,
+    /// \c _leaf(begin, end, _tmax) is called with the range [begin, end) of
+    /// leaf order positions of its primitives (see primitive()). The callback
+    /// may shrink \c _tmax to cull farther nodes. It returns \c true to stop
+    /// the traversal. Rays of both scalar types are supported.
+    template <class Scalar, class LeafFunc>
+    void traverse_leaves(const RayT<Scalar>& _ray, Scalar& _tmax, LeafFunc&& _leaf) const;
+
+    /// Traverse all nodes whose bounding box is hit by \c _ray in the
+    /// parameter interval [0, \c _tmax]. For each primitive of such a leaf,
+    /// \c _leaf(i, _tmax) is called with the primitive index \c i. The callback
+    /// may shrink \c _tmax to cull farther nodes. It returns \c true to stop
+    /// the traversal.
+    template <class Scalar, class LeafFunc>
+    void traverse(const RayT<Scalar>& _ray, Scalar& _tmax, LeafFunc&& _leaf) const;
+
+    /// Traverse all leaves whose bounding box is hit by at least one ray i of
+    /// \c _packet in the parameter interval [0, \c _tmax[i]]. For each such
+    /// leaf, \c _leaf(begin, end) is called with the range of leaf order
+    /// positions of its primitives. The callback may shrink the entries of
+    /// \c _tmax.
+    template <class LeafFunc>
+    void traverse_leaves(const RayPacket& _packet, const double* _tmax, LeafFunc&& _leaf) const;
+
+    /// Traverse all nodes whose bounding box is hit by at least one ray i of
+    /// \c _packet in the parameter interval [0, \c _tmax[i]]. For each
+    /// primitive of such a leaf, \c _leaf(i) is called with the primitive
+    /// index \c i. The callback may shrink the entries of \c _tmax.
+    template <class LeafFunc>
+    void traverse(const RayPacket& _packet, const double* _tmax, LeafFunc&& _leaf) const;
+
+private:
+
+    /// a node of the hierarchy, 32 bytes
+    struct Node
+    {
+        /// minimum point of the bounding box
+        float bb_min[3];
+        /// maximum point of the bounding box
+        float bb_max[3];
+        /// leaf: first entry in BVH::indices_, inner node: index of second child
+        int offset;
+        /// number of primitives of a leaf, 0 for inner nodes
+        unsigned short count;
+        /// split axis of inner nodes
+        unsigned short axis;
+    };
+
+    /// the input of build()
+    struct BuildInput;
+
+    /// Recursively build the subtree for indices_[_begin, _end) at depth
+    /// \c _depth and append its nodes to \c _nodes in depth-first order.
+    /// The offsets of inner nodes are relative to the first node of
+    /// \c _nodes. The second child is built by another thread if \c _threads
+    /// is larger than one, with the threads divided between the children.
+    void build_recursive(const BuildInput& _input, int _begin, int _end, int _depth,
+                         int _threads, std::vector<Node>& _nodes);
+
+    /// Position in indices_ at which [\c _begin, \c _end) is split for the
+    /// centroid box [\c _c_min, \c _c_max] with the binned surface area
+    /// heuristic. Partitions the range accordingly and stores the split axis
+    /// in \c _axis. Returns -1 if no split separates the centroids.
+    int split_sah(const BuildInput& _input, int _begin, int _end,
+                  const vec3& _c_min, const vec3& _c_max, int& _axis);
+
+private:
+
+    /// array of nodes in depth-first order
+    std::vector<Node> nodes_;
+
+    /// primitive indices, referenced by the leaves
+    std::vector<int> indices_;
+};
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+template <class Scalar, class LeafFunc>
+void BVH::traverse_leaves(const RayT<Scalar>& _ray, Scalar& _tmax, LeafFunc&& _leaf) const
+{
+    if (nodes_.empty()) return;
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    int box_tests = 0;
+
+    while (top)
+    {
+        const Node& node = nodes_[stack[--top]];
+        Scalar tmin = 0, tmax = _tmax;
+        ++box_tests;
+        if (!_ray.intersect_box(node.bb_min, node.bb_max, tmin, tmax)) continue;
+
+        if (node.count)
+        {
+            if (_leaf(node.offset, node.offset + node.count, _tmax)) break;
+        }
+        else
+        {
+            // push the far child first, such that the near child is visited first
+            const int first  = int(&node - &nodes_[0]) + 1;
+            const int second = node.offset;
+            if (_ray.direction[node.axis] < 0)
+            {
+                stack[top++] = first;
+                stack[top++] = second;
+            }
+            else
+            {
+                stack[top++] = second;
+                stack[top++] = first;
+            }
+        }
+    }
+
+    Statistics::count(Statistics::BOX_TESTS, box_tests);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar, class LeafFunc>
+void BVH::traverse(const RayT<Scalar>& _ray, Scalar& _tmax, LeafFunc&& _leaf) const
+{
+    traverse_leaves(_ray, _tmax, [&](int _begin, int _end, Scalar& _t)
+    {
+        for (int i = _begin; i < _end; ++i)
+            if (_leaf(indices_[i], _t)) return true;
+        return false;
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class LeafFunc>
+void BVH::traverse_leaves(const RayPacket& _packet, const double* _tmax, LeafFunc&& _leaf) const
+{
+    if (nodes_.empty() || _packet.size == 0) return;
+
+    // the rays are coherent, so the first ray decides the traversal order
+    const Ray& ray = _packet.ray[0];
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    int box_tests = 0;
+
+    while (top)
+    {
+        const Node& node = nodes_[stack[--top]];
+        box_tests += _packet.size;
+        if (!_packet.intersect_box(node.bb_min, node.bb_max, _tmax)) continue;
+
+        if (node.count)
+        {
+            _leaf(node.offset, node.offset + node.count);
+        }
+        else
+        {
+            const int first  = int(&node - &nodes_[0]) + 1;
+            const int second = node.offset;
+            if (ray.direction[node.axis] < 0)
+            {
+                stack[top++] = first;
+                stack[top++] = second;
+            }
+            else
+            {
+                stack[top++] = second;
+                stack[top++] = first;
+            }
+        }
+    }
+
+    Statistics::count(Statistics::BOX_TESTS, box_tests);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class LeafFunc>
+void BVH::traverse(const RayPacket& _packet, const double* _tmax, LeafFunc&& _leaf) const
+{
+    traverse_leaves(_packet, _tmax, [&](int _begin, int _end)
+    {
+        for (int i = _begin; i < _end; ++i)
+            _leaf(indices_[i]);
+    });
+}
+
+
+//=============================================================================
+#endif // BVH_H defined
+//=============================================================================
@@ -0,0 +1,115 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+void CameraPath::read(const std::string& _filename)
+{
+    std::ifstream ifs(_filename);
+    if (!ifs)
+        throw std::runtime_error("Cannot open file " + _filename);
+
+    num_frames_ = 0;
+    keys_.clear();
+    orbit_ = false;
+
+    const std::map<std::string, std::function<void(void)>> entityParser = {
+        {"frames", [&]() { ifs >> num_frames_; }},
+        {"key",    [&]() {
+            Key k;
+            ifs >> k.time >> k.eye >> k.center >> k.up >> k.fovy;
+            keys_.push_back(k);
+        }},
+        {"orbit",  [&]() {
+            ifs >> orbit_center_ >> orbit_radius_ >> orbit_height_ >> orbit_up_ >> orbit_fovy_;
+            orbit_ = true;
+        }}
+    };
+
+    // parse file
+    std::string token;
+    while (ifs && (ifs >> token) && (!ifs.eof())) {
+        if (token[0] == '#') {
+            ifs.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            continue;
+        }
+
+        if (entityParser.count(token) == 0)
+            throw std::runtime_error("Invalid token encountered: " + token);
+        entityParser.at(token)();
+    }
+
+    if (num_frames_ == 0)
+        throw std::runtime_error("No frames specified in " + _filename);
+    if (orbit_ == !keys_.empty())
+        throw std::runtime_error("Specify either keyframes or an orbit in " + _filename);
+
+    std::stable_sort(keys_.begin(), keys_.end(),
+                     [](const Key& a, const Key& b) { return a.time < b.time; });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Camera CameraPath::camera(unsigned int _frame, const Camera& _camera) const
+{
+    Camera c = _camera;
+
+    if (orbit_)
+    {
+        // one full turn, the last frame is followed by the first one
+        const double angle = 2.0 * M_PI * _frame / num_frames_;
+        c.eye    = vec3(orbit_center_[0] + orbit_radius_ * sin(angle),
+                        orbit_height_,
+                        orbit_center_[2] + orbit_radius_ * cos(angle));
+        c.center = orbit_center_;
+        c.up     = orbit_up_;
+        c.fovy   = orbit_fovy_;
+    }
+    else
+    {
+        // the frames span the time from the first to the last key
+        const double t0 = keys_.front().time, t1 = keys_.back().time;
+        const double t  = (num_frames_ > 1) ? t0 + (t1 - t0) * _frame / (num_frames_ - 1) : t0;
+
+        // find the keys a, b with a.time <= t <= b.time
+        size_t b = 1;
+        while (b < keys_.size() && keys_[b].time < t) ++b;
+        const Key& ka = keys_[std::min(b, keys_.size()) - 1];
+        const Key& kb = keys_[std::min(b, keys_.size() - 1)];
+        const double s = (kb.time > ka.time) ? (t - ka.time) / (kb.time - ka.time) : 0.0;
+
+        c.eye    = (1.0 - s) * ka.eye    + s * kb.eye;
+        c.center = (1.0 - s) * ka.center + s * kb.center;
+        c.up     = (1.0 - s) * ka.up     + s * kb.up;
+        c.fovy   = (1.0 - s) * ka.fovy   + s * kb.fovy;
+    }
+
+    c.init();
+    return c;
+}
+
+
+//=============================================================================
@@ -0,0 +1,86 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+
+//== INCLUDES =================================================================
+
+#include "Ray.h"
+#include "Camera.h"
+#include <string>
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class CameraPath CameraPath.h
+/// This class describes the camera motion of an animation. It is read from a
+/// text file in the style of the scene files, which specifies the number of
+/// frames and either a list of keyframes, between which the camera parameters
+/// are interpolated linearly, or a circular orbit around a center point:
+///
+///     # number of frames
+///     frames 90
+///     # keyframe: time, eye, center, up, fovy
+///     key  0.0   0 3 8   0 1 0   0 1 0   45
+///     key  1.0   8 3 0   0 1 0   0 1 0   45
+///     # or orbit: center, radius, eye height, up, fovy
+///     orbit  0 1 0   8   3   0 1 0   45
+class CameraPath
+{
+public:
+
+    /// Construct a path by reading it from file \c _filename
+    CameraPath(const std::string& _filename) { read(_filename); }
+
+    /// Read the path from file \c _filename. Throws std::runtime_error on failure.
+    void read(const std::string& _filename);
+
+    /// Number of frames of the animation
+    unsigned int num_frames() const { return num_frames_; }
+
+    /// Camera for frame \c _frame in [0, num_frames()). Image size and all
+    /// parameters that are not animated are taken from \c _camera.
+    Camera camera(unsigned int _frame, const Camera& _camera) const;
+
+private:
+
+    /// a camera keyframe
+    struct Key
+    {
+        /// time of the keyframe
+        double time;
+        /// camera parameters, see Camera
+        vec3 eye, center, up;
+        double fovy;
+    };
+
+    /// number of frames
+    unsigned int num_frames_;
+
+    /// keyframes, sorted by time
+    std::vector<Key> keys_;
+
+    /// is the camera moving on an orbit instead of along keys_?
+    bool orbit_;
+
+    /// orbit parameters, the eye circles around orbit_center_ at
+    /// distance orbit_radius_ and height orbit_height_
+    vec3 orbit_center_, orbit_up_;
+    double orbit_radius_, orbit_height_, orbit_fovy_;
+};
+
+
+//=============================================================================
+#endif // CAMERAPATH_H defined
+//=============================================================================
@@ -24,38 +24,65 @@ intersect(const Ray&  _ray,
           vec3&       _intersection_point,
           vec3&       _intersection_normal,
           double&     _intersection_t) const
+{
+    return intersect_impl(_ray, _intersection_point, _intersection_normal, _intersection_t);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Cylinder::
+intersect(const Rayf& _ray,
+          vec3f&      _intersection_point,
+          vec3f&      _intersection_normal,
+          float&      _intersection_t) const
+{
+    return intersect_impl(_ray, _intersection_point, _intersection_normal, _intersection_t);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+bool
+Cylinder::
+intersect_impl(const RayT<Scalar>& _ray,
+               Vec3T<Scalar>&      _intersection_point,
+               Vec3T<Scalar>&      _intersection_normal,
+               Scalar&             _intersection_t) const
 {
     // \todo Paste your assignment 1 solution here.
 	//default init arrays
 	//cuz it's floating points operation, there may be duplicate values t (with slightly difference caused by error) between plane and side, so we use size of 4 instead of 2.
-	std::array	<double, 4> intersect_t_arr;
-	std::array	<vec3, 4> intersect_point_arr;
-	std::array	<vec3, 4> intersection_normal_arr;
+	std::array	<Scalar, 4> intersect_t_arr;
+	std::array	<Vec3T<Scalar>, 4> intersect_point_arr;
+	std::array	<Vec3T<Scalar>, 4> intersection_normal_arr;
 
 	//(d.d - (d.a)^2)t^2 + 2[d.(o-c)-(d.a)((o-c).a)]t + (o-c)^2 - ((o-c).a)^2 - radius^2 = 0
-	vec3 o_c = _ray.origin - center;
+	const Vec3T<Scalar> c(center), a(axis);
+	const Scalar r(radius), half_height(height / 2);
+	Vec3T<Scalar> o_c = _ray.origin - c;
 
 	//(d.d - (d.a)^2)
-	double A = dot(_ray.direction, _ray.direction) - dot(axis, _ray.direction) * dot(axis, _ray.direction);
+	Scalar A = dot(_ray.direction, _ray.direction) - dot(a, _ray.direction) * dot(a, _ray.direction);
 	//2[d.(o-c)-(d.a)((o-c).a)]
-	double B = 2 * (dot(_ray.direction, o_c) - dot(_ray.direction, axis) * dot(o_c, axis));
+	Scalar B = 2 * (dot(_ray.direction, o_c) - dot(_ray.direction, a) * dot(o_c, a));
 	//(o-c)^2 - ((o-c).a)^2 - radius^2
-	double C = dot(o_c, o_c) - dot(o_c, axis) * dot(o_c, axis) - radius * radius;
+	Scalar C = dot(o_c, o_c) - dot(o_c, a) * dot(o_c, a) - r * r;
 
-	std::array<double, 2> sol = { 0,0 };
+	std::array<Scalar, 2> sol = { 0,0 };
 	size_t sol_num = solveQuadratic(A, B, C, sol);
 	int intersect_num = 0;
 
 	for (int i = 0; i < sol_num; i++) {
 		if (sol[i] >= 0
-			&& dot((_ray(sol[i]) - center), axis) < height / 2
-			&& dot((_ray(sol[i]) - center), axis) > -height / 2) {
+			&& dot((_ray(sol[i]) - c), a) < half_height
+			&& dot((_ray(sol[i]) - c), a) > -half_height) {
 			intersect_t_arr[intersect_num] = sol[i];
-			intersect_point_arr[intersect_num] = _ray(sol[i]);
-			intersection_normal_arr[intersect_num]
-				= normalize(_ray(sol[i]) - center - (dot(_ray.direction, axis)*sol[i] + dot(o_c, axis)) * axis);
-			if (dot(_ray.direction, intersection_normal_arr[intersect_num]) > 0)
-				intersection_normal_arr[intersect_num] = -intersection_normal_arr[intersect_num];
+			surface_impl(_ray, sol[i], intersect_point_arr[intersect_num], intersection_normal_arr[intersect_num]);
 			intersect_num++;
 		}
 	}	
@@ -64,7 +91,7 @@ intersect(const Ray&  _ray,
 
 	//final select
 	int index = 0; // argmin
-	double cur_min = intersect_t_arr[0];
+	Scalar cur_min = intersect_t_arr[0];
 	for (int i = 0; i < intersect_num; i++)
 		if (intersect_t_arr[i] < cur_min) index = i;
 
@@ -73,3 +100,166 @@ intersect(const Ray&  _ray,
 	_intersection_point = intersect_point_arr[index];
 	return true;
 }
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Cylinder::
+surface(const Ray& _ray, const Hit& _hit, vec3& _point, vec3& _normal) const
+{
+	surface_impl(_ray, _hit.t, _point, _normal);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Cylinder::
+surface(const Rayf& _ray, const Hitf& _hit, vec3f& _point, vec3f& _normal) const
+{
+	surface_impl(_ray, _hit.t, _point, _normal);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+void
+Cylinder::
+surface_impl(const RayT<Scalar>& _ray, Scalar _t, Vec3T<Scalar>& _point, Vec3T<Scalar>& _normal) const
+{
+	// the normal is the direction from the axis to the point, facing the ray
+	const Vec3T<Scalar> c(center), a(axis);
+	Vec3T<Scalar> o_c = _ray.origin - c;
+
+	_point  = _ray(_t);
+	_normal = normalize(_ray(_t) - c - (dot(_ray.direction, a)*_t + dot(o_c, a)) * a);
+	if (dot(_ray.direction, _normal) > 0)
+		_normal = -_normal;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Cylinder::
+intersect_packet(const RayPacket& _packet, Hit* _hits, bool* _hit) const
+{
+	// same computation as in Cylinder::intersect(), one lane at a time
+	const double ax = axis[0], ay = axis[1], az = axis[2];
+
+	for (int i = 0; i < _packet.size; ++i) {
+		const double dx = _packet.dx[i], dy = _packet.dy[i], dz = _packet.dz[i];
+		const double ox = _packet.ox[i], oy = _packet.oy[i], oz = _packet.oz[i];
+		const double ocx = ox - center[0], ocy = oy - center[1], ocz = oz - center[2];
+
+		const double d_d   = dx*dx + dy*dy + dz*dz;
+		const double d_a   = ax*dx + ay*dy + az*dz;
+		const double d_oc  = dx*ocx + dy*ocy + dz*ocz;
+		const double oc_a  = ocx*ax + ocy*ay + ocz*az;
+		const double oc_oc = ocx*ocx + ocy*ocy + ocz*ocz;
+
+		double s0, s1;
+		solveQuadraticSelect(d_d - d_a * d_a,
+		                     2 * (d_oc - d_a * oc_a),
+		                     oc_oc - oc_a * oc_a - radius * radius,
+		                     s0, s1);
+
+		// height of the intersection points along the axis
+		const double h0 = ((ox + s0*dx) - center[0]) * ax + ((oy + s0*dy) - center[1]) * ay + ((oz + s0*dz) - center[2]) * az;
+		const double h1 = ((ox + s1*dx) - center[0]) * ax + ((oy + s1*dy) - center[1]) * ay + ((oz + s1*dz) - center[2]) * az;
+		const bool valid0 = s0 >= 0 && h0 < height / 2 && h0 > -height / 2;
+		const bool valid1 = s1 >= 0 && h1 < height / 2 && h1 > -height / 2;
+
+		double t = NO_INTERSECTION;
+		t = valid0 ? s0 : t;
+		t = (valid1 && s1 < t) ? s1 : t;
+
+		_hit[i]    = (valid0 || valid1) && t <= _hits[i].t;
+		_hits[i].t = _hit[i] ? t : _hits[i].t;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Cylinder::
+occluded(const Ray& _ray, double _tmax) const
+{
+	return occluded_impl(_ray, _tmax);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Cylinder::
+occluded(const Rayf& _ray, float _tmax) const
+{
+	return occluded_impl(_ray, _tmax);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+bool
+Cylinder::
+occluded_impl(const RayT<Scalar>& _ray, Scalar _tmax) const
+{
+	// same quadratic as in Cylinder::intersect(), but without computing
+	// intersection points and normals
+	const Vec3T<Scalar> c(center), a(axis);
+	const Scalar r(radius), half_height(height / 2);
+	Vec3T<Scalar> o_c = _ray.origin - c;
+	Scalar d_a  = dot(_ray.direction, a);
+	Scalar oc_a = dot(o_c, a);
+
+	Scalar A = dot(_ray.direction, _ray.direction) - d_a * d_a;
+	Scalar B = 2 * (dot(_ray.direction, o_c) - d_a * oc_a);
+	Scalar C = dot(o_c, o_c) - oc_a * oc_a - r * r;
+
+	std::array<Scalar, 2> sol = { 0,0 };
+	size_t sol_num = solveQuadratic(A, B, C, sol);
+
+	for (size_t i = 0; i < sol_num; i++) {
+		if (sol[i] > 0 && sol[i] < _tmax) {
+			Scalar h = dot((_ray(sol[i]) - c), a);
+			if (h < half_height && h > -half_height)
+				return true;
+		}
+	}
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Cylinder::
+bounds(vec3& _bb_min, vec3& _bb_max) const
+{
+    // Along coordinate axis i, the caps extend by radius * sqrt(1 - axis[i]^2)
+    // around the end points center +- height/2 * axis.
+    vec3 extent;
+    for (int i = 0; i < 3; ++i)
+        extent[i] = 0.5 * height * std::abs(axis[i])
+                  + radius * std::sqrt(std::max(0.0, 1.0 - axis[i] * axis[i]));
+
+    _bb_min = center - extent;
+    _bb_max = center + extent;
+    return true;
+}
+
+
+//=============================================================================
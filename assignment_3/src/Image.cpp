@@ -1,6 +1,9 @@
 #include "Image.h"
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
 #include <lodepng.h>
 
 static bool check_ext(const std::string &path, const std::string &ext)
@@ -12,15 +15,77 @@ static bool check_ext(const std::string &path, const std::string &ext)
     return std::equal(ext.rbegin(), ext.rend(), path.rbegin());
 }
 
-bool Image::write(const std::string &_filename) const {
-    if (check_ext(_filename, ".png")) return write_png(_filename);
-    if (check_ext(_filename, ".tga")) return write_tga(_filename);
+Image::ToneMapOperator Image::parse_tone_map(const std::string &_name) {
+    if (_name == "clamp")    return CLAMP;
+    if (_name == "reinhard") return REINHARD;
+    throw std::runtime_error("Invalid tone map operator " + _name);
+}
+
+// The sRGB transfer function would need a pow() per color component, which
+// does not vectorize. Instead, the 8-bit codes of evenly spaced values in
+// [0,1] are tabulated; with 16384 entries, a code is off by at most one, and
+// only for values close to the boundary of two codes.
+static const int SRGB_TABLE_SIZE = 16384;
+
+static const unsigned char *srgb_table() {
+    static const std::vector<unsigned char> table = [] {
+        std::vector<unsigned char> t(SRGB_TABLE_SIZE);
+        for (int i = 0; i < SRGB_TABLE_SIZE; ++i) {
+            const double c = double(i) / (SRGB_TABLE_SIZE - 1);
+            const double s = (c <= 0.0031308) ? 12.92 * c : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+            t[i] = static_cast<unsigned char>(std::lround(255.0 * s));
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+// Tone map and quantize the _n color components _in to _out. The operator and
+// the encoding are template parameters, such that the loop has no branches
+// and the compiler can vectorize it (except for the table lookup of sRGB).
+template <Image::ToneMapOperator Op, bool Srgb>
+static void quantize_components(const float *_in, size_t _n, float _exposure, unsigned char *_out) {
+    const unsigned char *table = Srgb ? srgb_table() : nullptr;
+    for (size_t i = 0; i < _n; ++i) {
+        // max() first, such that NaN becomes 0
+        float c = std::max(0.0f, _in[i] * _exposure);
+        if (Op == Image::REINHARD) c = c / (1.0f + c);
+        c = std::min(c, 1.0f);
+        // the linear encoding truncates, as the ray tracer always did
+        _out[i] = Srgb ? table[int(c * (SRGB_TABLE_SIZE - 1) + 0.5f)]
+                       : static_cast<unsigned char>(255.0f * c);
+    }
+}
+
+std::vector<unsigned char> Image::quantize(const ToneMapping &_tone_mapping) const {
+    std::vector<unsigned char> bytes(pixels_.size());
+    const float *in = pixels_.data();
+    unsigned char *out = bytes.data();
+    const size_t n = pixels_.size();
+    const float e = _tone_mapping.exposure;
+
+    if (_tone_mapping.tone_map == REINHARD) {
+        if (_tone_mapping.srgb) quantize_components<REINHARD, true >(in, n, e, out);
+        else                    quantize_components<REINHARD, false>(in, n, e, out);
+    }
+    else {
+        if (_tone_mapping.srgb) quantize_components<CLAMP, true >(in, n, e, out);
+        else                    quantize_components<CLAMP, false>(in, n, e, out);
+    }
+    return bytes;
+}
+
+bool Image::write(const std::string &_filename, const ToneMapping &_tone_mapping) const {
+    if (check_ext(_filename, ".png")) return write_png(_filename, _tone_mapping);
+    if (check_ext(_filename, ".tga")) return write_tga(_filename, _tone_mapping);
+    if (check_ext(_filename, ".ppm")) return write_ppm(_filename, _tone_mapping);
+    if (check_ext(_filename, ".pfm")) return write_pfm(_filename);
 
     std::cerr << "No encoder for file name " << _filename << std::endl;
     return false;
 }
 
-bool Image::write_tga(const std::string &_filename) const
+bool Image::write_tga(const std::string &_filename, const ToneMapping &_tone_mapping) const
 {
     std::ofstream file(_filename, std::fstream::binary);
     if (!file) return false;
@@ -44,28 +109,60 @@ bool Image::write_tga(const std::string &_filename) const
     file.put(24); //bits per pixel
     file.put(0); //image descriptor
 
-    for (const vec3 &color : pixels_)
-    {
-        file.put(static_cast<unsigned char>(255.0 * color[2]));
-        file.put(static_cast<unsigned char>(255.0 * color[1]));
-        file.put(static_cast<unsigned char>(255.0 * color[0]));
-    }
+    // TGA origin is lower left, like ours, but the channels are BGR
+    std::vector<unsigned char> image_data = quantize(_tone_mapping);
+    for (size_t i = 0; i < image_data.size(); i += 3)
+        std::swap(image_data[i], image_data[i + 2]);
+    file.write(reinterpret_cast<const char *>(image_data.data()), image_data.size());
 
     file.close();
     return true;
 }
 
-bool Image::write_png(const std::string &_filename) const {
+bool Image::write_png(const std::string &_filename, const ToneMapping &_tone_mapping) const {
 
-    std::vector<uint8_t> image_data(pixels_.size() * 3);
+    const std::vector<unsigned char> bytes = quantize(_tone_mapping);
+    std::vector<uint8_t> image_data(bytes.size());
 
+    const size_t row_size = 3 * size_t(width());
     for (unsigned int y = 0; y < height(); ++y) {
-        for (unsigned int x = 0; x < width(); ++x) {
-            unsigned int row = height() - 1 - y; // flip vertically (PNG origin is upper left)
-            for (uint8_t c = 0; c < 3; ++c)
-                image_data[3 * (row * width() + x) + c] = static_cast<unsigned char>(255.0 * (*this)(x, y)[c]);
-        }
+        unsigned int row = height() - 1 - y; // flip vertically (PNG origin is upper left)
+        std::copy_n(&bytes[y * row_size], row_size, &image_data[row * row_size]);
     }
 
-    return lodepng::encode(_filename, image_data, width(), height(), LCT_RGB);
+    return lodepng::encode(_filename, image_data, width(), height(), LCT_RGB) == 0;
+}
+
+bool Image::write_ppm(const std::string &_filename, const ToneMapping &_tone_mapping) const {
+    std::ofstream file(_filename, std::fstream::binary);
+    if (!file) return false;
+    return write_ppm(file, _tone_mapping);
+}
+
+bool Image::write_ppm(std::ostream &_os, const ToneMapping &_tone_mapping) const {
+    _os << "P6\n" << width() << " " << height() << "\n255\n";
+
+    const std::vector<unsigned char> bytes = quantize(_tone_mapping);
+    const size_t row_size = 3 * size_t(width());
+    for (unsigned int y = height(); y-- > 0; ) // PPM origin is upper left
+        _os.write(reinterpret_cast<const char *>(&bytes[y * row_size]), row_size);
+
+    _os.flush();
+    return bool(_os);
+}
+
+bool Image::write_pfm(const std::string &_filename) const {
+    std::ofstream file(_filename, std::fstream::binary);
+    if (!file) return false;
+
+    // the sign of the scale gives the byte order of the floats, negative
+    // is little endian
+    const unsigned short one = 1;
+    unsigned char first_byte;
+    std::memcpy(&first_byte, &one, 1);
+    file << "PF\n" << width() << " " << height() << "\n" << (first_byte ? "-1.0" : "1.0") << "\n";
+
+    // PFM rows go from bottom to top, like ours
+    file.write(reinterpret_cast<const char *>(pixels_.data()), pixels_.size() * sizeof(float));
+    return bool(file);
 }
@@ -15,6 +15,7 @@
 
 #include "vec3.h"
 #include <vector>
+#include <string>
 #include <assert.h>
 #include <fstream>
 
@@ -23,10 +24,35 @@
 
 
 /// \class Image Image.h
-/// This class stores an image as a big array of colors, which are represented
-/// as vec3 values for RGB.
+/// This class stores an image as a big array of RGB colors, three floats per
+/// pixel. The colors are not bounded (high dynamic range); they are only
+/// mapped to [0,1] and quantized to 8 bits (see ToneMapping) when the image
+/// is written as PNG, TGA, or PPM. PFM files store the floats as they are.
 class Image
 {
+public:
+
+    /// operators mapping colors in [0,inf) to [0,1]
+    enum ToneMapOperator {CLAMP, REINHARD};
+
+    /// how colors are converted to 8 bits
+    struct ToneMapping
+    {
+        /// default: clamp the colors to [0,1] and quantize them linearly
+        ToneMapping() : exposure(1.0f), tone_map(CLAMP), srgb(false) {}
+
+        /// factor applied to the colors before tone mapping
+        float exposure;
+        /// CLAMP cuts off colors above 1, REINHARD maps c to c/(1+c)
+        ToneMapOperator tone_map;
+        /// encode with the sRGB transfer function instead of linearly
+        bool srgb;
+    };
+
+    /// Parse a tone map operator name ("clamp" or "reinhard").
+    /// Throws std::runtime_error for unknown names.
+    static ToneMapOperator parse_tone_map(const std::string& _name);
+
 public:
 
     /// Construct an image of size _width times _height
@@ -44,7 +70,7 @@ public:
     {
         width_  = _width;
         height_ = _height;
-        pixels_.resize(width_ * height_);
+        pixels_.resize(3 * size_t(width_) * height_);
     }
 
     /// Returns image width in pixels.
@@ -59,36 +85,67 @@ public:
         return height_;
     }
 
-    /// Read/write access to pixel (_x,_y). Use this to set the color by
-    /// image(x,y) = color;
-    vec3& operator()(unsigned int _x, unsigned int _y)
+    /// Set the color of pixel (_x,_y) by image.set(x,y,color);
+    template <class Scalar>
+    void set(unsigned int _x, unsigned int _y, const Vec3T<Scalar>& _color)
     {
-        assert(_x < width_);
-        assert(_y < height_);
-        return pixels_[_y*static_cast<unsigned int>(width_) + _x];
+        float* pixel = &pixels_[index(_x, _y)];
+        pixel[0] = float(_color[0]);
+        pixel[1] = float(_color[1]);
+        pixel[2] = float(_color[2]);
     }
 
     /// Read access to pixel (_x,_y).
-    const vec3& operator()(unsigned int _x, unsigned int _y) const
+    vec3f operator()(unsigned int _x, unsigned int _y) const
     {
-        assert(_x < width_);
-        assert(_y < height_);
-        return pixels_[_y*static_cast<unsigned int>(width_) + _x];
+        const float* pixel = &pixels_[index(_x, _y)];
+        return vec3f(pixel[0], pixel[1], pixel[2]);
     }
 
-    /// Writes the image in PNG or TGA format depending on the file name.
+    /// Map the colors to [0,1] and quantize them to 8 bits, as done for
+    /// writing PNG, TGA, and PPM files. Returns three bytes (RGB) per pixel,
+    /// in the order of the pixels in the image, i.e., row by row from the
+    /// bottom.
+    std::vector<unsigned char> quantize(const ToneMapping& _tone_mapping = ToneMapping()) const;
+
+    /// Writes the image in PNG, TGA, PPM, or PFM format depending on the
+    /// file name.
     /// \param[in] filename Filename to save the image to.
-    bool write(const std::string &_filename) const;
+    /// \param[in] _tone_mapping Conversion to 8 bits, unused for PFM.
+    bool write(const std::string &_filename, const ToneMapping& _tone_mapping = ToneMapping()) const;
 
     /// Writes the image in TGA format to a file.
     /// \param[in] _filename Filename to save the image to.
-    bool write_tga(const std::string &_filename) const;
-    bool write_png(const std::string &_filename) const; 
+    bool write_tga(const std::string &_filename, const ToneMapping& _tone_mapping = ToneMapping()) const;
+    bool write_png(const std::string &_filename, const ToneMapping& _tone_mapping = ToneMapping()) const;
+
+    /// Writes the image in binary PPM format to a file.
+    /// \param[in] _filename Filename to save the image to.
+    bool write_ppm(const std::string &_filename, const ToneMapping& _tone_mapping = ToneMapping()) const;
+
+    /// Writes the image in binary PPM format to a stream. Several images
+    /// written to the same stream form a sequence that can be piped into
+    /// video encoders (e.g. "ffmpeg -f image2pipe -i -").
+    /// \param[in] _os Stream to write the image to.
+    bool write_ppm(std::ostream &_os, const ToneMapping& _tone_mapping = ToneMapping()) const;
+
+    /// Writes the colors as floats in the Portable Float Map format (PFM),
+    /// without tone mapping, e.g. for compositing.
+    /// \param[in] _filename Filename to save the image to.
+    bool write_pfm(const std::string &_filename) const;
 
 private:
 
-    /// vector with all pixels in the image
-    std::vector<vec3> pixels_;
+    /// index of the red component of pixel (_x,_y) in pixels_
+    size_t index(unsigned int _x, unsigned int _y) const
+    {
+        assert(_x < width_);
+        assert(_y < height_);
+        return 3 * (size_t(_y) * width_ + _x);
+    }
+
+    /// RGB components of all pixels in the image, 3 floats per pixel
+    std::vector<float> pixels_;
     
     /// image width in pixels
     unsigned short int width_;
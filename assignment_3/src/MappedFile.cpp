@@ -0,0 +1,72 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "MappedFile.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#  include <fstream>
+#else // Unix
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+MappedFile::MappedFile(const std::string& _filename)
+: data_(nullptr), size_(0)
+{
+#ifdef _WIN32 // Windows
+    std::ifstream ifs(_filename, std::ios::binary);
+    if (!ifs) return;
+    buffer_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    if (buffer_.empty()) return;
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#else // Unix
+    int fd = open(_filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            data_ = static_cast<const char*>(p);
+            size_ = st.st_size;
+        }
+    }
+
+    // the mapping stays valid after closing the file descriptor
+    close(fd);
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if (data_) munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+
+//=============================================================================
@@ -0,0 +1,117 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+
+//== INCLUDES =================================================================
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class MappedFile MappedFile.h
+/// This class provides read-only access to the contents of a file. On Unix
+/// the file is memory-mapped, so no data is copied until it is accessed; on
+/// Windows the file is read into memory.
+class MappedFile
+{
+public:
+
+    /// Map the file \c _filename. Use is_open() to check for success.
+    MappedFile(const std::string& _filename);
+
+    /// Unmap the file
+    ~MappedFile();
+
+    /// Was the file mapped successfully?
+    bool is_open() const { return data_ != nullptr; }
+
+    /// First byte of the file contents
+    const char* data() const { return data_; }
+
+    /// Size of the file in bytes
+    size_t size() const { return size_; }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+
+    /// file contents
+    const char* data_;
+
+    /// size of the file in bytes
+    size_t size_;
+
+#ifdef _WIN32
+    /// buffer holding the file contents
+    std::vector<char> buffer_;
+#endif
+};
+
+
+//== BINARY I/O HELPERS =======================================================
+
+
+/// Append the bytes of \c _n values starting at \c _values to \c _buffer.
+template <class T>
+inline void write_binary(std::vector<char>& _buffer, const T* _values, size_t _n = 1)
+{
+    const char* bytes = reinterpret_cast<const char*>(_values);
+    _buffer.insert(_buffer.end(), bytes, bytes + _n * sizeof(T));
+}
+
+
+/// Copy \c _n values from \c _data to \c _values and advance \c _data.
+/// Returns false (and does not copy) if fewer bytes than required are left
+/// before \c _end.
+template <class T>
+inline bool read_binary(const char*& _data, const char* _end, T* _values, size_t _n = 1)
+{
+    const size_t bytes = _n * sizeof(T);
+    if (size_t(_end - _data) < bytes) return false;
+    std::memcpy(_values, _data, bytes);
+    _data += bytes;
+    return true;
+}
+
+
+/// 64-bit hash of the \c _size bytes at \c _data, in the style of FNV-1a
+/// but for 8 bytes per step. Used to identify file contents and to detect
+/// corrupt files, not for security.
+inline unsigned long long hash_binary(const char* _data, size_t _size)
+{
+    const unsigned long long prime = 1099511628211ULL;
+    unsigned long long h = 14695981039346656037ULL ^ _size;
+
+    size_t i = 0;
+    for (; i + 8 <= _size; i += 8)
+    {
+        unsigned long long w;
+        std::memcpy(&w, _data + i, 8);
+        h  = (h ^ w) * prime;
+        h ^= h >> 32; // the multiplication only carries bits upwards
+    }
+    for (; i < _size; ++i)
+        h = (h ^ static_cast<unsigned char>(_data[i])) * prime;
+
+    return h ^ (h >> 29);
+}
+
+
+//=============================================================================
+#endif // MAPPEDFILE_H defined
+//=============================================================================
@@ -11,15 +11,37 @@
 //== INCLUDES =================================================================
 
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "OffReader.h"
+#include "Statistics.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <fstream>
 #include <string>
 #include <stdexcept>
 #include <limits>
 
+#ifdef _WIN32
+#  include <process.h>
+#  define getpid _getpid
+#else // Unix
+#  include <unistd.h>
+#endif
+
 
 //== IMPLEMENTATION ===========================================================
 
 
+bool Mesh::cache_enabled = true;
+int  Mesh::bvh_leaf_size = 4;
+BVH::Method Mesh::bvh_method = BVH::SAH;
+
+
+//-----------------------------------------------------------------------------
+
+
 Mesh::Mesh(std::istream &is, const std::string &scenePath)
 {
     std::string meshFile, mode;
@@ -43,54 +65,58 @@ Mesh::Mesh(std::istream &is, const std::string &scenePath)
 bool Mesh::read(const std::string &_filename)
 {
     // read a mesh in OFF format
+    Profiler::Scope scope("read mesh " + _filename);
 
 
-    // open file
-    std::ifstream ifs(_filename);
-    if (!ifs)
+    // load the binary cache, if it is up to date, and store it again if
+    // its BVH had to be rebuilt for different build parameters
+    const std::string cache_filename = _filename + ".cache";
+    bool bvh_rebuilt = false;
+    if (cache_enabled && read_cache(cache_filename, _filename, &bvh_rebuilt))
     {
-        std::cerr << "Can't open " << _filename << "\n";
-        return false;
+        std::cout << "\n  read " << _filename << ": " << vertices_.size() << " vertices, "
+                  << triangles_.size() << " triangles (cached"
+                  << (bvh_rebuilt ? ", BVH rebuilt)" : ")");
+        if (bvh_rebuilt)
+            write_cache(cache_filename, _filename);
+        return true;
     }
 
 
-    // read OFF header
-    std::string s;
-    unsigned int nV, nF, dummy, i;
-    ifs >> s;
-    if (s != "OFF")
+    // map file
+    MappedFile file(_filename);
+    if (!file.is_open())
     {
-        std::cerr << "No OFF file\n";
+        std::cerr << "Can't open " << _filename << "\n";
         return false;
     }
-    ifs >> nV >> nF >> dummy;
-    std::cout << "\n  read " << _filename << ": " << nV << " vertices, " << nF << " triangles";
 
 
-    // read vertices
-    Vertex v;
-    vertices_.clear();
-    vertices_.reserve(nV);
-    for (i=0; i<nV; ++i)
+    // parse vertices and triangles
+    OffReader reader;
+    if (!reader.read(file.data(), file.size()))
     {
-        ifs >> v.position;
-        vertices_.push_back(v);
+        std::cerr << reader.error() << "\n";
+        return false;
     }
+    std::cout << "\n  read " << _filename << ": " << reader.positions().size() << " vertices, "
+              << reader.indices().size() / 3 << " triangles";
 
 
-    // read triangles
-    Triangle t;
-    triangles_.clear();
-    triangles_.reserve(nF);
-    for (i=0; i<nF; ++i)
-    {
-        ifs >> dummy >> t.i0 >> t.i1 >> t.i2;
-        triangles_.push_back(t);
-    }
+    // copy vertices
+    vertices_.resize(reader.positions().size());
+    for (size_t i = 0; i < vertices_.size(); ++i)
+        vertices_[i].position = reader.positions()[i];
 
 
-    // close file
-    ifs.close();
+    // copy triangles
+    triangles_.resize(reader.indices().size() / 3);
+    for (size_t i = 0; i < triangles_.size(); ++i)
+    {
+        triangles_[i].i0 = reader.indices()[3*i  ];
+        triangles_[i].i1 = reader.indices()[3*i+1];
+        triangles_[i].i2 = reader.indices()[3*i+2];
+    }
 
 
     // compute face and vertex normals
@@ -99,11 +125,182 @@ bool Mesh::read(const std::string &_filename)
     // compute bounding box
     compute_bounding_box();
 
+    // build acceleration structure
+    build_bvh();
+
+    // store the results for the next run (failure only costs the next run time)
+    if (cache_enabled)
+        write_cache(cache_filename, _filename);
+
 
     return true;
 }
 
 
+//-----------------------------------------------------------------------------
+
+
+/// header of the binary mesh cache, followed by the payload: the vertex
+/// array, the triangle array, and the serialized BVH
+struct MeshCacheHeader
+{
+    /// identifies the file type, "MESHCACH"
+    char magic[8];
+    /// incremented whenever the layout changes
+    unsigned int version;
+    /// sizes of Mesh::Vertex and Mesh::Triangle, guard against layout changes
+    unsigned int vertex_size, triangle_size;
+    /// is a BVH stored after the triangles?
+    unsigned int has_bvh;
+    /// parameters the BVH was built with, see BVH::builder_version,
+    /// Mesh::bvh_leaf_size, and Mesh::bvh_method
+    unsigned int bvh_builder, bvh_leaf_size, bvh_method;
+    /// size and content hash (hash_binary()) of the OFF file the cache was
+    /// created from
+    unsigned long long source_size, source_hash;
+    /// number of vertices and triangles
+    unsigned long long num_vertices, num_triangles;
+    /// bounding box of the mesh
+    double bb_min[3], bb_max[3];
+    /// size and checksum (hash_binary()) of the payload
+    unsigned long long payload_size, payload_hash;
+};
+
+static const char         mesh_cache_magic[8] = {'M','E','S','H','C','A','C','H'};
+static const unsigned int mesh_cache_version  = 3;
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::read_cache(const std::string& _filename, const std::string& _source_filename,
+                      bool* _bvh_rebuilt)
+{
+    MappedFile source(_source_filename);
+    if (!source.is_open()) return false;
+
+    MappedFile file(_filename);
+    if (!file.is_open()) return false;
+    const char* data = file.data();
+    const char* end  = data + file.size();
+
+    // check the layout and the size of the cache
+    MeshCacheHeader header;
+    if (!read_binary(data, end, &header) ||
+        std::memcmp(header.magic, mesh_cache_magic, sizeof(mesh_cache_magic)) != 0 ||
+        header.version       != mesh_cache_version ||
+        header.vertex_size   != sizeof(Vertex)     ||
+        header.triangle_size != sizeof(Triangle)   ||
+        header.source_size   != source.size()      ||
+        header.payload_size  != size_t(end - data) ||
+        header.num_vertices  > size_t(end - data) / sizeof(Vertex) ||
+        header.num_triangles > size_t(end - data) / sizeof(Triangle))
+        return false;
+
+    // check that the cache belongs to the current contents of the OFF file
+    // (touching or copying it keeps the cache valid) and is not corrupt
+    if (header.source_hash  != hash_binary(source.data(), source.size()) ||
+        header.payload_hash != hash_binary(data, end - data))
+        return false;
+
+    vertices_.resize(header.num_vertices);
+    triangles_.resize(header.num_triangles);
+    bool ok = read_binary(data, end, vertices_.data(), vertices_.size()) &&
+              read_binary(data, end, triangles_.data(), triangles_.size());
+    for (const Triangle& t: triangles_)
+    {
+        if (t.i0 < 0 || t.i1 < 0 || t.i2 < 0 ||
+            t.i0 >= int(vertices_.size()) || t.i1 >= int(vertices_.size()) || t.i2 >= int(vertices_.size()))
+            ok = false;
+    }
+    bb_min_ = vec3(header.bb_min[0], header.bb_min[1], header.bb_min[2]);
+    bb_max_ = vec3(header.bb_max[0], header.bb_max[1], header.bb_max[2]);
+
+    // take the stored BVH if it was built with the current parameters and
+    // matches the triangles, rebuild it otherwise
+    if (ok)
+    {
+        const bool bvh_current = header.has_bvh &&
+                                 header.bvh_builder   == BVH::builder_version &&
+                                 header.bvh_leaf_size == unsigned(bvh_leaf_size) &&
+                                 header.bvh_method    == unsigned(bvh_method);
+        if (bvh_current && bvh_.deserialize(data, end) && bvh_.size() == int(triangles_.size()))
+        {
+            build_triangle_arrays();
+        }
+        else
+        {
+            build_bvh();
+            if (_bvh_rebuilt) *_bvh_rebuilt = true;
+        }
+    }
+    else
+    {
+        vertices_.clear();
+        triangles_.clear();
+    }
+
+    return ok;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::write_cache(const std::string& _filename, const std::string& _source_filename) const
+{
+    MappedFile source(_source_filename);
+    if (!source.is_open()) return false;
+
+    MeshCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, mesh_cache_magic, sizeof(mesh_cache_magic));
+    header.version       = mesh_cache_version;
+    header.vertex_size   = sizeof(Vertex);
+    header.triangle_size = sizeof(Triangle);
+    header.has_bvh       = 1;
+    header.bvh_builder   = BVH::builder_version;
+    header.bvh_leaf_size = bvh_leaf_size;
+    header.bvh_method    = bvh_method;
+    header.source_size   = source.size();
+    header.source_hash   = hash_binary(source.data(), source.size());
+    header.num_vertices  = vertices_.size();
+    header.num_triangles = triangles_.size();
+    for (int c = 0; c < 3; ++c)
+    {
+        header.bb_min[c] = bb_min_[c];
+        header.bb_max[c] = bb_max_[c];
+    }
+
+    // write the payload after a placeholder, then the completed header
+    std::vector<char> buffer;
+    write_binary(buffer, &header);
+    write_binary(buffer, vertices_.data(), vertices_.size());
+    write_binary(buffer, triangles_.data(), triangles_.size());
+    bvh_.serialize(buffer);
+    header.payload_size = buffer.size() - sizeof(header);
+    header.payload_hash = hash_binary(buffer.data() + sizeof(header), header.payload_size);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+
+    // write to a temporary file first, such that concurrent runs never
+    // see a partially written cache. Its name is unique to the process and
+    // the call, such that concurrent writers never share it.
+    static std::atomic<unsigned int> num_writes(0);
+    const std::string tmp_filename = _filename + "." + std::to_string(getpid())
+                                   + "." + std::to_string(num_writes++) + ".tmp";
+    std::ofstream ofs(tmp_filename, std::ios::binary);
+    if (!ofs) return false;
+    ofs.write(buffer.data(), buffer.size());
+    ofs.close();
+    if (!ofs || std::rename(tmp_filename.c_str(), _filename.c_str()) != 0)
+    {
+        std::remove(tmp_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+
 //-----------------------------------------------------------------------------
 
 // Determine the weights by which to scale triangle (p0, p1, p2)'s normal when
@@ -128,6 +325,8 @@ void angleWeights(const vec3 &p0, const vec3 &p1, const vec3 &p2,
 
 void Mesh::compute_normals()
 {
+    Profiler::Scope scope("normals");
+
     // compute triangle normals
     for (Triangle& t: triangles_)
     {
@@ -195,6 +394,8 @@ void Mesh::compute_normals()
 
 void Mesh::compute_bounding_box()
 {
+    Profiler::Scope scope("bounding box");
+
     bb_min_ = vec3(std::numeric_limits<double>::max());
     bb_max_ = vec3(std::numeric_limits<double>::lowest());
 
@@ -208,47 +409,94 @@ void Mesh::compute_bounding_box()
 
 //-----------------------------------------------------------------------------
 
-bool intersect_bounding_box_faces(const vec3& min, const vec3& max, const Ray& _ray, int axis) {
-	//Then for that particular axis, determine the t value that draws the ray to the same plane as the faces of the bounding box
-	double t = (min[axis] - _ray.origin[axis]) / _ray.direction[axis];
-	if (t < 0)
-		return false;
-	vec3 r = _ray(t);
-	double error = 1e-4;
-	//Compute the intersection point on the plane, then for each axis, determine if the intersection point falls inside the range of the faces
-	for (int i = 0; i < 3; i++) {
-		if (i != axis)
-			if (r[i] < min[i] - error || r[i] > max[i] + error)
-				return false;
-	}
-	return true;
+
+void Mesh::build_bvh()
+{
+    Statistics::PhaseTimer timer(Statistics::BUILD);
+
+    std::vector<vec3> bb_min(triangles_.size()), bb_max(triangles_.size());
+    for (size_t i = 0; i < triangles_.size(); ++i)
+    {
+        const vec3& p0 = vertices_[triangles_[i].i0].position;
+        const vec3& p1 = vertices_[triangles_[i].i1].position;
+        const vec3& p2 = vertices_[triangles_[i].i2].position;
+        bb_min[i] = min(p0, min(p1, p2));
+        bb_max[i] = max(p0, max(p1, p2));
+    }
+    bvh_.build(bb_min, bb_max, bvh_leaf_size, bvh_method);
+
+    build_triangle_arrays();
 }
 
-bool Mesh::intersect_bounding_box(const Ray& _ray) const
+
+//-----------------------------------------------------------------------------
+
+
+void Mesh::build_triangle_arrays()
 {
+    // gather the vertices in the leaf order of the BVH
+    TriangleArrays<double>& ta = triangle_arrays_;
+    const int n = bvh_.size();
+    for (int c = 0; c < 3; ++c)
+    {
+        ta.v0[c].assign(n + LANES - 1, 0.0);
+        ta.v1[c].assign(n + LANES - 1, 0.0);
+        ta.v2[c].assign(n + LANES - 1, 0.0);
+    }
+    ta.index.assign(n + LANES - 1, -1);
 
-    /** \todo
-    * Intersect the ray `_ray` with the axis-aligned bounding box of the mesh.
-    * Note that the minimum and maximum point of the bounding box are stored
-    * in the member variables `bb_min_` and `bb_max_`. Return whether the ray
-    * intersects the bounding box.
-    * This function is ued in `Mesh::intersect()` to avoid the intersection test
-    * with all triangles of every mesh in the scene. The bounding boxes are computed
-    * in `Mesh::compute_bounding_box()`.
-    */
-	
-	//For each axis (x, y, z), define a moved vec3 move_max and a move_min to move bb_max_, and bb_min_ to the same plane respectively.
-	vec3 move_max;
-	vec3 move_min;
-	for (int axis = 0; axis < 3; axis++) {
-		move_max = bb_max_;
-		move_max[axis] = bb_min_[axis];
-		move_min = bb_min_;
-		move_min[axis] = bb_max_[axis];
-		if (intersect_bounding_box_faces(move_min, bb_max_, _ray, axis) || intersect_bounding_box_faces(bb_min_, move_max, _ray, axis))
-			return true;
-	}
-	return false;
+    for (int k = 0; k < n; ++k)
+    {
+        const int i = bvh_.primitive(k);
+        const vec3& v0 = vertices_[triangles_[i].i0].position;
+        const vec3& v1 = vertices_[triangles_[i].i1].position;
+        const vec3& v2 = vertices_[triangles_[i].i2].position;
+        for (int c = 0; c < 3; ++c)
+        {
+            ta.v0[c][k] = v0[c];
+            ta.v1[c][k] = v1[c];
+            ta.v2[c][k] = v2[c];
+        }
+        ta.index[k] = i;
+    }
+
+    // single precision copy, rounded from the double precision data
+    TriangleArrays<float>& tf = triangle_arrays_float_;
+    for (int c = 0; c < 3; ++c)
+    {
+        tf.v0[c].assign(ta.v0[c].begin(), ta.v0[c].end());
+        tf.v1[c].assign(ta.v1[c].begin(), ta.v1[c].end());
+        tf.v2[c].assign(ta.v2[c].begin(), ta.v2[c].end());
+    }
+    tf.index = ta.index;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <>
+const Mesh::TriangleArrays<double>& Mesh::triangle_arrays<double>() const
+{
+    return triangle_arrays_;
+}
+
+
+template <>
+const Mesh::TriangleArrays<float>& Mesh::triangle_arrays<float>() const
+{
+    return triangle_arrays_float_;
+}
+
+
+//-----------------------------------------------------------------------------
+
+bool Mesh::intersect_bounding_box(const Ray& _ray) const
+{
+    // slab test against the box, only intersections in front of the ray count
+    double tmin = 0.0, tmax = std::numeric_limits<double>::infinity();
+    Statistics::count(Statistics::BOX_TESTS);
+    return _ray.intersect_box(bb_min_, bb_max_, tmin, tmax);
 }
 
 
@@ -260,44 +508,145 @@ bool Mesh::intersect(const Ray& _ray,
                      vec3&      _intersection_normal,
                      double&    _intersection_t ) const
 {
-    // check bounding box intersection
-    if (!intersect_bounding_box(_ray))
-    {
-        return false;
-    }
+    Hit hit;
+    if (!intersect_impl(_ray, hit)) return false;
+    surface_impl(_ray, hit, _intersection_point, _intersection_normal);
+    _intersection_t = hit.t;
+    return true;
+}
 
-    vec3   p, n;
-    double t;
 
-    _intersection_t = NO_INTERSECTION;
+//-----------------------------------------------------------------------------
 
-    // for each triangle
-    for (const Triangle& triangle : triangles_)
+
+bool Mesh::intersect(const Rayf& _ray,
+                     vec3f&      _intersection_point,
+                     vec3f&      _intersection_normal,
+                     float&      _intersection_t ) const
+{
+    Hitf hit;
+    if (!intersect_impl(_ray, hit)) return false;
+    surface_impl(_ray, hit, _intersection_point, _intersection_normal);
+    _intersection_t = hit.t;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::intersect(const Ray& _ray, Hit& _hit) const
+{
+    return intersect_impl(_ray, _hit);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::intersect(const Rayf& _ray, Hitf& _hit) const
+{
+    return intersect_impl(_ray, _hit);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Mesh::surface(const Ray& _ray, const Hit& _hit, vec3& _point, vec3& _normal) const
+{
+    surface_impl(_ray, _hit, _point, _normal);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Mesh::surface(const Rayf& _ray, const Hitf& _hit, vec3f& _point, vec3f& _normal) const
+{
+    surface_impl(_ray, _hit, _point, _normal);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+bool Mesh::intersect_impl(const RayT<Scalar>& _ray, HitT<Scalar>& _hit) const
+{
+    // the root of bvh_ encloses the bounding box of the mesh, so there is
+    // no separate intersect_bounding_box() test needed here
+    Scalar t[LANES], a[LANES], b[LANES];
+    bool   hit[LANES];
+    int    closest = -1;
+    Scalar alpha = 0, beta = 0;
+    Scalar tmin = std::numeric_limits<Scalar>::infinity();
+    const WatertightRay<Scalar> ray(_ray);
+    int tests = 0;
+
+    // for each leaf with a bounding box hit by the ray
+    bvh_.traverse_leaves(_ray, tmin, [&](int begin, int end, Scalar& tmax)
     {
-        // does ray intersect triangle?
-        if (intersect_triangle(triangle, _ray, p, n, t))
+        tests += end - begin;
+        for (int first = begin; first < end; first += LANES)
         {
-            // is intersection closer than previous intersections?
-            if (t < _intersection_t)
+            // intersect LANES triangles at once
+            intersect_triangle_lanes(triangle_arrays<Scalar>(), ray, first, t, a, b, hit);
+
+            for (int k = 0; k < LANES && first + k < end; ++k)
             {
-                // store data of this intersection
-                _intersection_t      = t;
-                _intersection_point  = p;
-                _intersection_normal = n;
+                // is intersection closer than previous intersections? Ties are
+                // resolved by triangle index to match a linear scan over triangles_.
+                const int i = triangle_arrays_.index[first + k];
+                if (hit[k] && (t[k] < tmax || (t[k] == tmax && i < closest)))
+                {
+                    tmax    = t[k];
+                    closest = i;
+                    alpha   = a[k];
+                    beta    = b[k];
+                }
             }
         }
-    }
+        return false;
+    });
+
+    Statistics::count(Statistics::TRIANGLE_TESTS, tests);
+    if (closest < 0) return false;
 
-    return (_intersection_t != NO_INTERSECTION);
+    // only store the closest triangle, point and normal are computed by
+    // surface() if this is the closest hit of the scene
+    _hit.t         = tmin;
+    _hit.primitive = closest;
+    _hit.alpha     = alpha;
+    _hit.beta      = beta;
+    return true;
 }
 
+
 //-----------------------------------------------------------------------------
 
-double Mesh::determinant(double a, double b, double c, double d, double e, double f, double g, double h, double i) const
+
+template <class Scalar>
+void Mesh::surface_impl(const RayT<Scalar>&  _ray,
+                        const HitT<Scalar>&  _hit,
+                        Vec3T<Scalar>&       _point,
+                        Vec3T<Scalar>&       _normal) const
 {
-	return a * (e * i - f * h) - b * (d * i - f * g) + c * (d * h - e * g);
+    typedef Vec3T<Scalar> Vec;
+
+    const Triangle& triangle = triangles_[_hit.primitive];
+    const Scalar    alpha    = _hit.alpha;
+    const Scalar    beta     = _hit.beta;
+    _point = _ray(_hit.t);
+    if (draw_mode_ == FLAT) {
+        _normal = normalize(Vec(triangle.normal));
+    }
+    else {
+        _normal = normalize(alpha * Vec(vertices_[triangle.i0].normal) + beta * Vec(vertices_[triangle.i1].normal) + (1 - alpha - beta) * Vec(vertices_[triangle.i2].normal));
+    }
 }
 
+
 //-----------------------------------------------------------------------------
 
 
@@ -309,109 +658,172 @@ intersect_triangle(const Triangle&  _triangle,
                    vec3&            _intersection_normal,
                    double&          _intersection_t) const
 {
-    const vec3& p0 = vertices_[_triangle.i0].position;
-    const vec3& p1 = vertices_[_triangle.i1].position;
-    const vec3& p2 = vertices_[_triangle.i2].position;
+	// barycentric coordinates and ray parameter by the watertight test
+	double alpha, beta, t;
+	if (!intersect_triangle(_triangle, _ray, alpha, beta, t))
+		return false;
 
-    /** \todo
-    * - intersect _ray with _triangle
-    * - store intersection point in `_intersection_point`
-    * - store ray parameter in `_intersection_t`
-    * - store normal at intersection point in `_intersection_normal`.
-    * - Depending on the member variable `draw_mode_`, use either the triangle
-    *  normal (`Triangle::normal`) or interpolate the vertex normals (`Vertex::normal`).
-    * - return `true` if there is an intersection with t > 0 (in front of the viewer)
-    *
-    * Hint: Rearrange `ray.origin + t*ray.dir = a*p0 + b*p1 + (1-a-b)*p2` to obtain a solvable
-    * system for a, b and t.
-    * Refer to [Cramer's Rule](https://en.wikipedia.org/wiki/Cramer%27s_rule) to easily solve it.
-     */
+	_intersection_t = t;
+	_intersection_point = _ray(_intersection_t);
+	if (draw_mode_ == FLAT) {
+		_intersection_normal = normalize(_triangle.normal);
+	}
+	else if (draw_mode_ == PHONG) {
+		_intersection_normal = normalize(alpha * vertices_[_triangle.i0].normal + beta * vertices_[_triangle.i1].normal + (1 - alpha - beta) * vertices_[_triangle.i2].normal);
+	}
+	return true;
+}
 
 
-    /*vec3 v1 = p1 - p0;
-    vec3 v2 = p2 - p0;
-    vec3 v3 = - _ray.direction;
-    vec3 v4 = _ray.origin - p0;
+//-----------------------------------------------------------------------------
 
-    double det = dot(v1, cross(v2, v3));
-    double det_1 =  dot(v4, cross(v2, v3));
-    double det_2 = dot(v1, cross(v4, v3));
-    double det_3 = dot(v1, cross(v2, v4));
 
-    if(det < 0)         // -1e-4< && <1e-4
-        return false;
+bool
+Mesh::
+intersect_triangle(const Triangle&  _triangle,
+                   const Ray&       _ray,
+                   double&          _alpha,
+                   double&          _beta,
+                   double&          _t) const
+{
+	// watertight test, see intersect_triangle_watertight()
+	const WatertightRay<double> ray(_ray);
+	const vec3& v0 = vertices_[_triangle.i0].position;
+	const vec3& v1 = vertices_[_triangle.i1].position;
+	const vec3& v2 = vertices_[_triangle.i2].position;
+
+	return intersect_triangle_watertight(ray,
+	                                     v0[ray.kx], v0[ray.ky], v0[ray.kz],
+	                                     v1[ray.kx], v1[ray.ky], v1[ray.kz],
+	                                     v2[ray.kx], v2[ray.ky], v2[ray.kz],
+	                                     _t, _alpha, _beta);
+}
 
-    double a = det_1/det;
-    double b = det_2/det;
-    double r = 1-a-b;
-    double t = det_3/det;
 
-     if(t < 0 || a < 0 || b < 0 || r < 0 )
-        return false;
+//-----------------------------------------------------------------------------
 
-    _intersection_t = t;
-    _intersection_point = _ray(_intersection_t);
 
-    if(draw_mode_ == FLAT)
-        _intersection_normal = normalize(_triangle.normal);
-    else
-        _intersection_normal = normalize(a * vertices_[_triangle.i0].normal + b * vertices_[_triangle.i1].normal 
-                                            + r * vertices_[_triangle.i2].normal);
-    
-    if(dot(_intersection_normal, _ray.direction) < 0) // 1e-2 ?
-        _intersection_normal = - _intersection_normal;
-
-    return true;*/
-
-
-	/*  Drivation
-		ray.origin + t*ray.dir = a*p0 + b*p1 + (1-a-b)*p2 ->
-	 	ray.origin + t*ray.dir = a*p0 + b*p1 +p2 - a*p2 - b*p2 ->
-		ray.origin + t*ray.dir = a*(p0-p2) + b*(p1-p2) + p2 ->
-		a*(p2-p0) + b*(p2-p1) + ray.dir*t = p2 - ray.origin ->
-								|a|
-		[p2-p0 p2-p1 ray.dir] * |b| = [p2 - ray.origin] ->
-								|t|
-
-		|xp2-xp0 xp2-xp1 xd|   |a|   |xp2 - xo|
-		|yp2-yp0 yp2-yp1 yd| * |b| = |yp2 - yo|
-		|zp2-zp0 zp2-zp1 zd|   |t| 	 |zp2 - zo| A solvable linear system
-	*/
-
-	//Use Cramer's Rule to solve the above linear system
-	vec3 v0 = vertices_[_triangle.i0].position;
-	vec3 v1 = vertices_[_triangle.i1].position;
-	vec3 v2 = vertices_[_triangle.i2].position;
-	vec3 col1 = v2 - v0;
-	vec3 col2 = v2 - v1;
-	vec3 col3 = _ray.direction;
-	vec3 res = v2 - _ray.origin;
-
-
-	double determinant_original = dot(cross(col1,col2), col3);
-	if (determinant_original < 1e-4 && determinant_original > -1e-4)
-		return false;
-	double alpha = dot(cross(res, col2), col3) / determinant_original;
-	double beta = dot(cross(col1, res), col3) / determinant_original;
-	double t = dot(cross(col1, col2), res) / determinant_original;
+void Mesh::intersect_packet(const RayPacket& _packet, Hit* _hits, bool* _hit) const
+{
+    const TriangleArrays<double>& ta = triangle_arrays_;
 
-	if (alpha<0 || beta <0 || (1-alpha-beta)<0 || t<0)
-		return false;
-	else {
-		_intersection_t = t;
-		_intersection_point = _ray(_intersection_t);
-		if (draw_mode_ == FLAT) {
-			_intersection_normal = normalize(_triangle.normal);
-		}
-		else if (draw_mode_ == PHONG) {
-			_intersection_normal = normalize(alpha * vertices_[_triangle.i0].normal + beta * vertices_[_triangle.i1].normal + (1 - alpha - beta) * vertices_[_triangle.i2].normal);
-		}
-		return true;
-	}
+    double tmax[RayPacket::MAX_SIZE], alpha[RayPacket::MAX_SIZE], beta[RayPacket::MAX_SIZE];
+    int    closest[RayPacket::MAX_SIZE];
+    WatertightRay<double> rays[RayPacket::MAX_SIZE];
+    bool coherent = true;
+    for (int i = 0; i < _packet.size; ++i)
+    {
+        tmax[i]    = _hits[i].t;
+        closest[i] = -1;
+        rays[i]    = WatertightRay<double>(_packet.ray[i]);
+        coherent   = coherent && rays[i].kx == rays[0].kx && rays[i].ky == rays[0].ky;
+    }
+
+    // same computation and tie breaking as in intersect_impl(), but for all rays
+    auto test = [&](int _i, int _j, const double* _v0, const double* _v1, const double* _v2,
+                    int _kx, int _ky, int _kz)
+    {
+        double t, a, b;
+        const int  idx = ta.index[_j];
+        const bool hit = intersect_triangle_watertight(rays[_i],
+                                                       _v0[_kx], _v0[_ky], _v0[_kz],
+                                                       _v1[_kx], _v1[_ky], _v1[_kz],
+                                                       _v2[_kx], _v2[_ky], _v2[_kz],
+                                                       t, a, b)
+                      & ((t < tmax[_i]) | ((t == tmax[_i]) & ((closest[_i] < 0) | (idx < closest[_i]))));
+        tmax[_i]    = hit ? t   : tmax[_i];
+        closest[_i] = hit ? idx : closest[_i];
+        alpha[_i]   = hit ? a   : alpha[_i];
+        beta[_i]    = hit ? b   : beta[_i];
+    };
+
+    int tests = 0;
+    bvh_.traverse_leaves(_packet, tmax, [&](int begin, int end)
+    {
+        tests += (end - begin) * _packet.size;
+        for (int j = begin; j < end; ++j)
+        {
+            const double v0[3] = { ta.v0[0][j], ta.v0[1][j], ta.v0[2][j] };
+            const double v1[3] = { ta.v1[0][j], ta.v1[1][j], ta.v1[2][j] };
+            const double v2[3] = { ta.v2[0][j], ta.v2[1][j], ta.v2[2][j] };
 
+            // coherent rays (e.g. primary rays) share the permutation of the
+            // coordinates, otherwise every ray uses its own
+            if (coherent)
+            {
+                for (int i = 0; i < _packet.size; ++i)
+                    test(i, j, v0, v1, v2, rays[0].kx, rays[0].ky, rays[0].kz);
+            }
+            else
+            {
+                for (int i = 0; i < _packet.size; ++i)
+                    test(i, j, v0, v1, v2, rays[i].kx, rays[i].ky, rays[i].kz);
+            }
+        }
+    });
+    Statistics::count(Statistics::TRIANGLE_TESTS, tests);
+
+    for (int i = 0; i < _packet.size; ++i)
+    {
+        _hit[i] = (closest[i] >= 0);
+        if (_hit[i])
+        {
+            _hits[i].t         = tmax[i];
+            _hits[i].primitive = closest[i];
+            _hits[i].alpha     = alpha[i];
+            _hits[i].beta      = beta[i];
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::occluded(const Ray& _ray, double _tmax) const
+{
+    return occluded_impl(_ray, _tmax);
 }
 
 
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::occluded(const Rayf& _ray, float _tmax) const
+{
+    return occluded_impl(_ray, _tmax);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+bool Mesh::occluded_impl(const RayT<Scalar>& _ray, Scalar _tmax) const
+{
+    Scalar t[LANES], a[LANES], b[LANES];
+    bool   hit[LANES];
+    const WatertightRay<Scalar> ray(_ray);
+
+    // stop at the first triangle hit in (0, _tmax)
+    bool occluded = false;
+    int  tests    = 0;
+    bvh_.traverse_leaves(_ray, _tmax, [&](int begin, int end, Scalar&)
+    {
+        for (int first = begin; first < end; first += LANES)
+        {
+            intersect_triangle_lanes(triangle_arrays<Scalar>(), ray, first, t, a, b, hit);
+            tests += std::min(int(LANES), end - first);
+            for (int k = 0; k < LANES && first + k < end; ++k)
+                occluded = occluded || (hit[k] && t[k] > 0 && t[k] < _tmax);
+            if (occluded) return true;
+        }
+        return false;
+    });
+
+    Statistics::count(Statistics::TRIANGLE_TESTS, tests);
+    return occluded;
+}
 
 
 //=============================================================================
@@ -15,6 +15,8 @@
 //== INCLUDES =================================================================
 
 #include "Object.h"
+#include "BVH.h"
+#include "TriangleIntersection.h"
 #include <vector>
 #include <string>
 
@@ -47,6 +49,94 @@ public:
                            vec3&      _intersection_normal,
                            double&    _intersection_t) const override;
 
+    /// Single precision version of intersect(), using the single precision
+    /// copy of the triangle data.
+    /// This function overrides Object::intersect().
+    virtual bool intersect(const Rayf& _ray,
+                           vec3f&      _intersection_point,
+                           vec3f&      _intersection_normal,
+                           float&      _intersection_t) const override;
+
+    /// Find the closest triangle hit by \c _ray, and store the ray parameter,
+    /// the index of the triangle, and the barycentric coordinates in \c _hit.
+    /// This function overrides Object::intersect().
+    virtual bool intersect(const Ray& _ray, Hit& _hit) const override;
+
+    /// Single precision version of intersect(const Ray&, Hit&) const.
+    /// This function overrides Object::intersect().
+    virtual bool intersect(const Rayf& _ray, Hitf& _hit) const override;
+
+    /// Compute the intersection point and the (flat or interpolated) normal
+    /// of a hit found by intersect().
+    /// This function overrides Object::surface().
+    virtual void surface(const Ray& _ray, const Hit& _hit, vec3& _point, vec3& _normal) const override;
+
+    /// Single precision version of surface().
+    /// This function overrides Object::surface().
+    virtual void surface(const Rayf& _ray, const Hitf& _hit, vec3f& _point, vec3f& _normal) const override;
+
+    /// Intersect the mesh with all rays of \c _packet.
+    /// This function overrides Object::intersect_packet().
+    virtual void intersect_packet(const RayPacket& _packet, Hit* _hits, bool* _hit) const override;
+
+    /// Does \c _ray hit the mesh at any ray parameter in (0, \c _tmax)?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray, double _tmax) const override;
+
+    /// Single precision version of occluded().
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Rayf& _ray, float _tmax) const override;
+
+    /// Report the bounding box computed by compute_bounding_box().
+    virtual bool bounds(vec3& _bb_min, vec3& _bb_max) const override
+    {
+        _bb_min = bb_min_;
+        _bb_max = bb_max_;
+        return true;
+    }
+
+public:
+
+    // The triangle kernel and its data layout are public, such that
+    // kernel_bench can measure it on its own.
+
+    /// number of triangles intersected together by intersect_triangle_lanes()
+    static const int LANES = 4;
+
+    /// Per-triangle data of the intersection kernels, gathered at load time
+    /// and stored as structure of arrays (one array per coordinate) in the
+    /// leaf order of bvh_. The watertight test (see
+    /// intersect_triangle_watertight()) only needs the vertex positions.
+    /// Each array is padded by LANES-1 degenerate triangles, such that the
+    /// kernels can always load LANES entries. The arrays are kept in double
+    /// and in single precision, the latter for the single precision render
+    /// mode.
+    template <class Scalar>
+    struct TriangleArrays
+    {
+        /// first vertex (Triangle::i0)
+        std::vector<Scalar> v0[3];
+        /// second vertex (Triangle::i1)
+        std::vector<Scalar> v1[3];
+        /// third vertex (Triangle::i2)
+        std::vector<Scalar> v2[3];
+        /// index of the triangle (for array Mesh::triangles_)
+        std::vector<int> index;
+    };
+
+    /// Intersect the ray \c _ray with the LANES triangles stored at the
+    /// positions [\c _first, \c _first + LANES) of \c _arrays. For each
+    /// lane k, store whether the ray hits the triangle with t >= 0 in
+    /// \c _hit[k], and the ray parameter and barycentric coordinates of the
+    /// hit in \c _t[k], \c _alpha[k], and \c _beta[k]. The results are the
+    /// same as computed by intersect_triangle(). The computation is done in
+    /// the precision of \c _ray.
+    template <class Scalar>
+    static void intersect_triangle_lanes(const TriangleArrays<Scalar>& _arrays,
+                                         const WatertightRay<Scalar>& _ray, int _first,
+                                         Scalar* _t, Scalar* _alpha, Scalar* _beta,
+                                         bool* _hit);
+
 private:
     /// a vertex consists of a position and a normal
     struct Vertex
@@ -71,15 +161,53 @@ private:
     };
 
 public:
-    /// Read mesh from an OFF file
+    /// Read mesh from an OFF file. If a valid binary cache (see read_cache())
+    /// exists next to the file, it is loaded instead; otherwise the cache is
+    /// written after parsing, unless cache_enabled is false.
     bool read(const std::string &_filename);
 
+    /// Load vertices, triangles, normals, bounding box, and BVH from the
+    /// binary cache \c _filename, which is memory-mapped instead of parsed.
+    /// Fails if the cache is missing, corrupt (checksum mismatch), or written
+    /// for different contents of \c _source_filename (compared by a hash of
+    /// the file contents, not by its modification time). If the stored BVH
+    /// was built with different parameters (see bvh_leaf_size, bvh_method,
+    /// and BVH::builder_version), only the BVH is rebuilt and \c *_bvh_rebuilt
+    /// is set to true.
+    bool read_cache(const std::string& _filename, const std::string& _source_filename,
+                    bool* _bvh_rebuilt = nullptr);
+
+    /// Write the loaded mesh and its BVH to the binary cache \c _filename.
+    /// The data is stored in native byte order and is not portable.
+    bool write_cache(const std::string& _filename, const std::string& _source_filename) const;
+
+    /// Use binary mesh caches in read()? Enabled by default.
+    static bool cache_enabled;
+
+    /// Maximum number of triangles per BVH leaf, see BVH::build()
+    static int bvh_leaf_size;
+
+    /// Split algorithm of the BVH (SAH by default), see BVH::build()
+    static BVH::Method bvh_method;
+
     /// Compute normal vectors for triangles and vertices
     void compute_normals();
 
     /// Compute the axis-aligned bounding box, store minimum and maximum point in bb_min_ and bb_max_
     void compute_bounding_box();
 
+    /// Build the bounding volume hierarchy over the triangles and the
+    /// triangle arrays used by the intersection kernels
+    void build_bvh();
+
+    /// Fill triangle_arrays_ and triangle_arrays_float_ in the leaf order of
+    /// the already built bvh_
+    void build_triangle_arrays();
+
+    /// The triangle arrays of precision \c Scalar
+    template <class Scalar>
+    const TriangleArrays<Scalar>& triangle_arrays() const;
+
     /// Does \c _ray intersect the bounding box of the mesh?
     bool intersect_bounding_box(const Ray& _ray) const;
 
@@ -97,10 +225,30 @@ public:
                             vec3&            _intersection_normal,
                             double&          _intersection_t) const;
 
-	///compute the determinant a 3X3 matrix
-	double determinant(double a, double b, double c, double d, double e, double f, double g, double h, double i) const;
+    /// Intersect a triangle with a ray, computing only the ray parameter
+    /// \c _t and the barycentric coordinates (\c _alpha, \c _beta,
+    /// 1 - \c _alpha - \c _beta) of the intersection with respect to the
+    /// vertices i0, i1, and i2. Return whether there is an intersection with t >= 0.
+    bool intersect_triangle(const Triangle&  _triangle,
+                            const Ray&       _ray,
+                            double&          _alpha,
+                            double&          _beta,
+                            double&          _t) const;
 
+    /// intersect() for both scalar types, evaluated in precision \c Scalar
+    template <class Scalar>
+    bool intersect_impl(const RayT<Scalar>& _ray, HitT<Scalar>& _hit) const;
 
+    /// surface() for both scalar types, evaluated in precision \c Scalar
+    template <class Scalar>
+    void surface_impl(const RayT<Scalar>&  _ray,
+                      const HitT<Scalar>&  _hit,
+                      Vec3T<Scalar>&       _point,
+                      Vec3T<Scalar>&       _normal) const;
+
+    /// occluded() for both scalar types, evaluated in precision \c Scalar
+    template <class Scalar>
+    bool occluded_impl(const RayT<Scalar>& _ray, Scalar _tmax) const;
 
 private:
     /// Does this mesh use flat or Phong shading?
@@ -116,9 +264,53 @@ private:
     vec3 bb_min_;
     /// Maximum point of the bounding box
     vec3 bb_max_;
+
+    /// Bounding volume hierarchy over triangles_
+    BVH bvh_;
+
+    /// Triangle data for the intersection kernels, in the leaf order of bvh_
+    TriangleArrays<double> triangle_arrays_;
+
+    /// Single precision copy of triangle_arrays_
+    TriangleArrays<float> triangle_arrays_float_;
 };
 
 
+//== IMPLEMENTATION ===========================================================
+
+
+template <class Scalar>
+inline void Mesh::intersect_triangle_lanes(const TriangleArrays<Scalar>& _arrays,
+                                           const WatertightRay<Scalar>& _ray, int _first,
+                                           Scalar* _t, Scalar* _alpha, Scalar* _beta,
+                                           bool* _hit)
+{
+    // the permutation of the ray selects the arrays, such that the loop
+    // over the lanes is the same for all rays
+    const WatertightRay<Scalar> ray = _ray;
+    const Scalar* ax = &_arrays.v0[_ray.kx][_first]; const Scalar* ay = &_arrays.v0[_ray.ky][_first]; const Scalar* az = &_arrays.v0[_ray.kz][_first];
+    const Scalar* bx = &_arrays.v1[_ray.kx][_first]; const Scalar* by = &_arrays.v1[_ray.ky][_first]; const Scalar* bz = &_arrays.v1[_ray.kz][_first];
+    const Scalar* cx = &_arrays.v2[_ray.kx][_first]; const Scalar* cy = &_arrays.v2[_ray.ky][_first]; const Scalar* cz = &_arrays.v2[_ray.kz][_first];
+
+    // The loop is only vectorized if it writes to local arrays of the
+    // scalar type, which cannot alias the ray or the triangle data. The
+    // results are copied to the outputs afterwards.
+    Scalar t[LANES], alpha[LANES], beta[LANES], hit[LANES];
+    for (int k = 0; k < LANES; ++k)
+    {
+        hit[k] = intersect_triangle_watertight(ray,
+                                               ax[k], ay[k], az[k],
+                                               bx[k], by[k], bz[k],
+                                               cx[k], cy[k], cz[k],
+                                               t[k], alpha[k], beta[k]) ? Scalar(1) : Scalar(0);
+    }
+    for (int k = 0; k < LANES; ++k)
+    {
+        _t[k] = t[k]; _alpha[k] = alpha[k]; _beta[k] = beta[k]; _hit[k] = hit[k] != 0;
+    }
+}
+
+
 //=============================================================================
 #endif // MESH_H defined
 //=============================================================================
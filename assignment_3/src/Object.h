@@ -14,6 +14,7 @@
 //== INCLUDES =================================================================
 
 #include "Ray.h"
+#include "RayPacket.h"
 #include "vec3.h"
 #include "Material.h"
 
@@ -24,6 +25,37 @@
 //== CLASS DEFINITION =========================================================
 
 
+/// \class HitT Object.h
+/// The closest intersection of a ray, as found by the traversal of the
+/// scene: the ray parameter, the object, the primitive within the object,
+/// and the barycentric coordinates within the primitive. The intersection
+/// point and the surface normal are not part of it; they are computed by
+/// Object::surface() once for the final hit.
+template <class Scalar>
+struct HitT
+{
+    /// ray parameter of the intersection
+    Scalar t = std::numeric_limits<Scalar>::infinity();
+    /// index of the object (for array Scene::objects), or -1 if there is no intersection
+    int object = -1;
+    /// index of the primitive within the object (e.g., of the triangle of a
+    /// Mesh), or -1 for objects that consist of a single primitive
+    int primitive = -1;
+    /// barycentric coordinates of the intersection with respect to the first
+    /// and the second vertex of the primitive
+    Scalar alpha = 0, beta = 0;
+};
+
+/// double precision hit, used throughout the ray tracer
+typedef HitT<double> Hit;
+
+/// single precision hit, used by the single precision render mode
+typedef HitT<float> Hitf;
+
+
+//-----------------------------------------------------------------------------
+
+
 /// \class Object Object.h
 /// This class implements an abstract class for an object.
 /// Every derived object type will inherit the material property, and it
@@ -49,6 +81,122 @@ public:
                            vec3&       _intersection_normal,
                            double&     _intersection_t) const = 0;
 
+    /// Single precision version of intersect(), used by the single precision
+    /// render mode (see Scene::render()). The default implementation converts
+    /// \c _ray to double precision and calls intersect(), such that object
+    /// types only need to provide the double precision version.
+    virtual bool intersect(const Rayf& _ray,
+                           vec3f&      _intersection_point,
+                           vec3f&      _intersection_normal,
+                           float&      _intersection_t) const
+    {
+        vec3   p, n;
+        double t;
+        if (!intersect(Ray(_ray), p, n, t)) return false;
+        _intersection_point  = vec3f(p);
+        _intersection_normal = vec3f(n);
+        _intersection_t      = float(t);
+        return true;
+    }
+
+    /// Find the closest intersection of the object with \c _ray like
+    /// intersect(), but only store the ray parameter, the primitive, and the
+    /// barycentric coordinates in \c _hit (the object index is set by the
+    /// caller). Point and normal are computed later by surface(), and only
+    /// for the closest hit of the scene. The default implementation calls
+    /// intersect() and stores only the ray parameter.
+    /// \param[in] _ray the ray to intersect the object with
+    /// \param[out] _hit the intersection, only changed if there is one
+    virtual bool intersect(const Ray& _ray, Hit& _hit) const
+    {
+        vec3   p, n;
+        double t;
+        if (!intersect(_ray, p, n, t)) return false;
+        _hit.t = t;
+        return true;
+    }
+
+    /// Single precision version of intersect(const Ray&, Hit&) const. The
+    /// default implementation calls the single precision intersect().
+    virtual bool intersect(const Rayf& _ray, Hitf& _hit) const
+    {
+        vec3f p, n;
+        float t;
+        if (!intersect(_ray, p, n, t)) return false;
+        _hit.t = t;
+        return true;
+    }
+
+    /// Compute the intersection point and the surface normal of \c _hit,
+    /// which was found by intersect(const Ray&, Hit&) const for \c _ray. The
+    /// results are the same as computed by intersect(). The default
+    /// implementation intersects \c _ray once more.
+    /// \param[in] _ray the ray that hit the object
+    /// \param[in] _hit the intersection
+    /// \param[out] _point the point of intersection
+    /// \param[out] _normal the surface normal at the intersection point
+    virtual void surface(const Ray& _ray, const Hit& /*_hit*/, vec3& _point, vec3& _normal) const
+    {
+        double t;
+        intersect(_ray, _point, _normal, t);
+    }
+
+    /// Single precision version of surface(). The default implementation
+    /// calls the single precision intersect().
+    virtual void surface(const Rayf& _ray, const Hitf& /*_hit*/, vec3f& _point, vec3f& _normal) const
+    {
+        float t;
+        intersect(_ray, _point, _normal, t);
+    }
+
+    /// Intersect the object with all rays of \c _packet. For every lane i,
+    /// \c _hits[i].t holds an upper bound of the ray parameter on input. If
+    /// the closest intersection of ray i has a parameter t <= \c _hits[i].t,
+    /// then \c _hit[i] is set to \c true and \c _hits[i] is set like by
+    /// intersect(const Ray&, Hit&) const; otherwise \c _hit[i] is set to
+    /// \c false and \c _hits[i] is not changed. The computed t is the same
+    /// that intersect() would return for the single ray. The default
+    /// implementation calls intersect() for each lane.
+    /// \param[in] _packet the rays to intersect the object with
+    /// \param[in,out] _hits per-lane ray parameter bound and intersection
+    /// \param[out] _hit per-lane intersection flag
+    virtual void intersect_packet(const RayPacket& _packet, Hit* _hits, bool* _hit) const
+    {
+        for (int i = 0; i < _packet.size; ++i)
+        {
+            Hit hit = _hits[i];
+            _hit[i] = intersect(_packet.ray[i], hit) && hit.t <= _hits[i].t;
+            if (_hit[i]) _hits[i] = hit;
+        }
+    }
+
+    /// Does \c _ray hit the object at any ray parameter in (0, \c _tmax)?
+    /// This any-hit query is used for shadow rays. It may stop at the first
+    /// hit found and does not compute intersection points or normals.
+    /// The default implementation falls back to Object::intersect().
+    /// \param[in] _ray the ray to intersect the object with
+    /// \param[in] _tmax upper bound of the ray parameter interval
+    virtual bool occluded(const Ray& _ray, double _tmax) const
+    {
+        vec3   p, n;
+        double t;
+        return intersect(_ray, p, n, t) && t > 0 && t < _tmax;
+    }
+
+    /// Single precision version of occluded(). The default implementation
+    /// converts \c _ray to double precision and calls occluded().
+    virtual bool occluded(const Rayf& _ray, float _tmax) const
+    {
+        return occluded(Ray(_ray), double(_tmax));
+    }
+
+    /// Compute the axis-aligned bounding box of the object. Return \c false
+    /// if the object is unbounded (e.g., a plane), which is the default for
+    /// object types that do not override this function.
+    /// \param[out] _bb_min minimum point of the bounding box
+    /// \param[out] _bb_max maximum point of the bounding box
+    virtual bool bounds(vec3& /*_bb_min*/, vec3& /*_bb_max*/) const { return false; }
+
     /// parse object properties from an input stream
     virtual void parse(std::istream &is) { throw std::logic_error("Unimplemented"); }
 
@@ -0,0 +1,372 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "OffReader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+/// minimum number of bytes parsed by each thread
+static const size_t min_bytes_per_thread = 1 << 16;
+
+
+//-----------------------------------------------------------------------------
+
+
+static inline bool is_space(char _c)
+{
+    return _c == ' ' || _c == '\t' || _c == '\n' || _c == '\r' || _c == '\v' || _c == '\f';
+}
+
+
+static inline bool is_digit(char _c)
+{
+    return _c >= '0' && _c <= '9';
+}
+
+
+static inline void skip_space(const char*& _p, const char* _end)
+{
+    while (_p != _end && is_space(*_p)) ++_p;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Parse the integer starting at \c _p, which has to be followed by white
+/// space or \c _end, and advance \c _p behind it.
+static bool parse_int(const char*& _p, const char* _end, long long& _value)
+{
+    const char* p = _p;
+    bool negative = false;
+    if (p != _end && (*p == '+' || *p == '-')) negative = (*p++ == '-');
+
+    const char* digits = p;
+    long long value = 0;
+    while (p != _end && is_digit(*p))
+    {
+        if (p - digits >= 18) return false; // out of range
+        value = 10 * value + (*p++ - '0');
+    }
+    if (p == digits || (p != _end && !is_space(*p))) return false;
+
+    _value = negative ? -value : value;
+    _p = p;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Parse the floating point number starting at \c _p, which has to be
+/// followed by white space or \c _end, and advance \c _p behind it. The
+/// result is correctly rounded: numbers whose decimal mantissa and exponent
+/// are exactly representable as doubles are converted with a single
+/// multiplication or division, all others by strtod().
+static bool parse_double(const char*& _p, const char* _end, double& _value)
+{
+    // exactly representable powers of ten
+    static const double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* p = _p;
+    bool negative = false;
+    if (p != _end && (*p == '+' || *p == '-')) negative = (*p++ == '-');
+
+    // mantissa, at most 19 significant digits fit into 64 bits
+    uint64_t mantissa = 0;
+    int      num_digits = 0, exponent = 0;
+    bool     any_digit = false, truncated = false;
+    for (; p != _end && is_digit(*p); ++p)
+    {
+        any_digit = true;
+        if (num_digits < 19)
+        {
+            mantissa = 10 * mantissa + (*p - '0');
+            if (mantissa) ++num_digits;
+        }
+        else
+        {
+            ++exponent;
+            truncated = true;
+        }
+    }
+    if (p != _end && *p == '.')
+    {
+        for (++p; p != _end && is_digit(*p); ++p)
+        {
+            any_digit = true;
+            if (num_digits < 19)
+            {
+                mantissa = 10 * mantissa + (*p - '0');
+                if (mantissa) ++num_digits;
+                --exponent;
+            }
+            else truncated = true;
+        }
+    }
+    if (!any_digit) return false;
+
+    if (p != _end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        bool exponent_negative = false;
+        if (p != _end && (*p == '+' || *p == '-')) exponent_negative = (*p++ == '-');
+        if (p == _end || !is_digit(*p)) return false;
+        int e = 0;
+        for (; p != _end && is_digit(*p); ++p)
+            if (e < 100000) e = 10 * e + (*p - '0');
+        exponent += exponent_negative ? -e : e;
+    }
+    if (p != _end && !is_space(*p)) return false;
+
+    if (!truncated && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+    {
+        // both operands are exact, so the result is correctly rounded
+        double value = double(mantissa);
+        value = (exponent < 0) ? value / pow10[-exponent] : value * pow10[exponent];
+        _value = negative ? -value : value;
+    }
+    else
+    {
+        char buffer[128];
+        const size_t length = p - _p;
+        if (length >= sizeof(buffer)) return false;
+        std::memcpy(buffer, _p, length);
+        buffer[length] = '\0';
+        char* parsed_end;
+        _value = std::strtod(buffer, &parsed_end);
+        if (parsed_end != buffer + length) return false;
+    }
+
+    _p = p;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool OffReader::read(const char* _data, size_t _size, unsigned int _num_threads)
+{
+    positions_.clear();
+    indices_.clear();
+    error_.clear();
+
+    const char* p   = _data;
+    const char* end = _data + _size;
+
+    // header: "OFF" and the numbers of vertices, faces, and edges
+    skip_space(p, end);
+    if (end - p < 3 || std::strncmp(p, "OFF", 3) != 0 || (end - p > 3 && !is_space(p[3])))
+    {
+        error_ = "No OFF file";
+        return false;
+    }
+    p += 3;
+
+    long long counts[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        skip_space(p, end);
+        if (!parse_int(p, end, counts[i]) || counts[i] < 0 || counts[i] > (1LL << 30))
+        {
+            error_ = "Invalid OFF header";
+            return false;
+        }
+    }
+
+    positions_.resize(counts[0]);
+    indices_.resize(3 * counts[1]);
+
+    if (!read_lines(p, end, _num_threads) && !read_tokens(p, end))
+    {
+        positions_.clear();
+        indices_.clear();
+        if (error_.empty()) error_ = "Unexpected end of OFF file";
+        return false;
+    }
+
+    for (int i: indices_)
+    {
+        if (i < 0 || i >= int(positions_.size()))
+        {
+            positions_.clear();
+            indices_.clear();
+            error_ = "Vertex index out of range";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool OffReader::read_lines(const char* _begin, const char* _end, unsigned int _num_threads)
+{
+    unsigned int num_threads = _num_threads ? _num_threads : std::thread::hardware_concurrency();
+    num_threads = unsigned(std::max<size_t>(1, std::min<size_t>(std::max(num_threads, 1u),
+                                                               (_end - _begin) / min_bytes_per_thread)));
+
+    // split the body into chunks that start at the beginning of a line
+    std::vector<const char*> chunks(num_threads + 1, _end);
+    chunks[0] = _begin;
+    for (unsigned int k = 1; k < num_threads; ++k)
+    {
+        const char* p = std::max(chunks[k-1], _begin + (_end - _begin) * k / num_threads);
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', _end - p));
+        chunks[k] = nl ? nl + 1 : _end;
+    }
+
+    // call _func(line_begin, line_end) for all lines in chunk k
+    auto for_each_line = [&](unsigned int k, const std::function<bool(const char*, const char*)>& _func) -> bool
+    {
+        for (const char* p = chunks[k]; p < chunks[k+1]; )
+        {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', chunks[k+1] - p));
+            const char* line_end = nl ? nl : chunks[k+1];
+            if (!_func(p, line_end)) return false;
+            p = line_end + 1;
+        }
+        return true;
+    };
+    auto is_empty = [](const char* _b, const char* _e) -> bool
+    {
+        skip_space(_b, _e);
+        return _b == _e;
+    };
+    auto run = [&](const std::function<void(unsigned int)>& _func)
+    {
+        std::vector<std::thread> threads;
+        for (unsigned int k = 1; k < num_threads; ++k)
+            threads.emplace_back(_func, k);
+        _func(0);
+        for (std::thread& t: threads) t.join();
+    };
+
+    // first pass: count the non-empty lines of each chunk
+    std::vector<size_t> first_line(num_threads + 1, 0);
+    run([&](unsigned int k)
+    {
+        size_t n = 0;
+        for_each_line(k, [&](const char* _b, const char* _e) { n += !is_empty(_b, _e); return true; });
+        first_line[k+1] = n;
+    });
+    for (unsigned int k = 0; k < num_threads; ++k)
+        first_line[k+1] += first_line[k];
+    if (first_line[num_threads] < positions_.size() + indices_.size() / 3)
+        return false;
+
+    // second pass: parse one vertex or face per non-empty line
+    std::vector<char> ok(num_threads, 0);
+    run([&](unsigned int k)
+    {
+        size_t line = first_line[k];
+        ok[k] = for_each_line(k, [&](const char* _b, const char* _e)
+        {
+            return is_empty(_b, _e) || read_element(line++, _b, _e);
+        });
+    });
+
+    return std::find(ok.begin(), ok.end(), 0) == ok.end();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool OffReader::read_element(size_t _line, const char* _begin, const char* _end)
+{
+    const size_t num_vertices  = positions_.size();
+    const size_t num_triangles = indices_.size() / 3;
+    const char* p = _begin;
+
+    if (_line < num_vertices)
+    {
+        vec3& v = positions_[_line];
+        for (int c = 0; c < 3; ++c)
+        {
+            skip_space(p, _end);
+            if (!parse_double(p, _end, v[c])) return false;
+        }
+    }
+    else if (_line < num_vertices + num_triangles)
+    {
+        long long n, idx[3];
+        skip_space(p, _end);
+        if (!parse_int(p, _end, n) || n != 3) return false;
+        for (int c = 0; c < 3; ++c)
+        {
+            skip_space(p, _end);
+            if (!parse_int(p, _end, idx[c]) || idx[c] < 0 || idx[c] >= (1LL << 31)) return false;
+            indices_[3 * (_line - num_vertices) + c] = int(idx[c]);
+        }
+    }
+    else return true; // trailing lines are ignored
+
+    // anything else on the line (e.g. colors) breaks the one element per
+    // line layout, the caller falls back to read_tokens()
+    skip_space(p, _end);
+    return p == _end;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool OffReader::read_tokens(const char* _begin, const char* _end)
+{
+    const char* p = _begin;
+
+    for (vec3& v: positions_)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            skip_space(p, _end);
+            if (!parse_double(p, _end, v[c])) return false;
+        }
+    }
+
+    // each face starts with its number of vertices, which is ignored
+    long long n, idx;
+    for (size_t i = 0; i < indices_.size(); i += 3)
+    {
+        skip_space(p, _end);
+        if (!parse_int(p, _end, n)) return false;
+        for (int c = 0; c < 3; ++c)
+        {
+            skip_space(p, _end);
+            if (!parse_int(p, _end, idx) || idx < 0 || idx >= (1LL << 31)) return false;
+            indices_[i + c] = int(idx);
+        }
+    }
+
+    return true;
+}
+
+
+//=============================================================================
@@ -0,0 +1,78 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef OFFREADER_H
+#define OFFREADER_H
+
+
+//== INCLUDES =================================================================
+
+#include "vec3.h"
+#include <string>
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class OffReader OffReader.h
+/// This class parses triangle meshes in OFF format from a memory buffer
+/// (typically a MappedFile). Numbers are converted without iostreams or
+/// locales, and the vertex and face blocks are split at line boundaries into
+/// chunks that are parsed by several threads. Files that do not store one
+/// element per line are parsed token by token instead, which gives the same
+/// result as reading them with operator>>.
+class OffReader
+{
+public:
+
+    /// Parse the OFF file stored in [\c _data, \c _data + \c _size).
+    /// Use \c _num_threads threads (0: one per hardware thread); small files
+    /// are always parsed by the calling thread. Returns false and sets
+    /// error() if the file is not a valid OFF file.
+    bool read(const char* _data, size_t _size, unsigned int _num_threads = 0);
+
+    /// vertex positions
+    const std::vector<vec3>& positions() const { return positions_; }
+
+    /// vertex indices, three per triangle
+    const std::vector<int>& indices() const { return indices_; }
+
+    /// description of the last error
+    const std::string& error() const { return error_; }
+
+private:
+
+    /// parse the body line by line, split into chunks processed in parallel
+    bool read_lines(const char* _begin, const char* _end, unsigned int _num_threads);
+
+    /// parse the body token by token, like operator>> would
+    bool read_tokens(const char* _begin, const char* _end);
+
+    /// parse the vertex or triangle in the non-empty line number \c _line
+    /// of the body, which spans [\c _begin, \c _end)
+    bool read_element(size_t _line, const char* _begin, const char* _end);
+
+private:
+
+    /// vertex positions
+    std::vector<vec3> positions_;
+
+    /// vertex indices, three per triangle
+    std::vector<int> indices_;
+
+    /// description of the last error
+    std::string error_;
+};
+
+
+//=============================================================================
+#endif // OFFREADER_H defined
+//=============================================================================
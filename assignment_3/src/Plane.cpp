@@ -35,20 +35,142 @@ intersect(const Ray& _ray,
           vec3&      _intersection_normal,
           double&    _intersection_t ) const
 {
-    //todo Copy your assignment 1 solution here.
-	double dot_no = dot((center - _ray.origin), normal);
-	double dot_nd = dot(normal, _ray.direction);
+    return intersect_impl(_ray, _intersection_point, _intersection_normal, _intersection_t);
+}
 
-	if (dot_nd < 1e-7 && dot_nd > -1e-7)
-		return false;
 
-	_intersection_t = dot_no / dot_nd;
-	_intersection_point = _ray(_intersection_t);
-	_intersection_normal = normal;
+//-----------------------------------------------------------------------------
+
+
+bool
+Plane::
+intersect(const Rayf& _ray,
+          vec3f&      _intersection_point,
+          vec3f&      _intersection_normal,
+          float&      _intersection_t ) const
+{
+    return intersect_impl(_ray, _intersection_point, _intersection_normal, _intersection_t);
+}
 
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+bool
+Plane::
+intersect_impl(const RayT<Scalar>& _ray,
+               Vec3T<Scalar>&      _intersection_point,
+               Vec3T<Scalar>&      _intersection_normal,
+               Scalar&             _intersection_t ) const
+{
+    //todo Copy your assignment 1 solution here.
+	const Vec3T<Scalar> c(center), n(normal);
+	Scalar dot_no = dot((c - _ray.origin), n);
+	Scalar dot_nd = dot(n, _ray.direction);
+	if (dot_nd < Scalar(1e-7) && dot_nd > Scalar(-1e-7))
+		return false;
+	_intersection_t = dot_no / dot_nd;
+	surface_impl(_ray, _intersection_t, _intersection_point, _intersection_normal);
 	return (_intersection_t > 0) ? true : false;
     return false;
 }
 
 
+//-----------------------------------------------------------------------------
+
+
+void
+Plane::
+surface(const Ray& _ray, const Hit& _hit, vec3& _point, vec3& _normal) const
+{
+	surface_impl(_ray, _hit.t, _point, _normal);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Plane::
+surface(const Rayf& _ray, const Hitf& _hit, vec3f& _point, vec3f& _normal) const
+{
+	surface_impl(_ray, _hit.t, _point, _normal);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+void
+Plane::
+surface_impl(const RayT<Scalar>& _ray, Scalar _t, Vec3T<Scalar>& _point, Vec3T<Scalar>& _normal) const
+{
+	_point  = _ray(_t);
+	_normal = Vec3T<Scalar>(normal);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Plane::
+intersect_packet(const RayPacket& _packet, Hit* _hits, bool* _hit) const
+{
+	const double nx = normal[0], ny = normal[1], nz = normal[2];
+
+	for (int i = 0; i < _packet.size; ++i) {
+		double dot_no = (center[0] - _packet.ox[i]) * nx
+		              + (center[1] - _packet.oy[i]) * ny
+		              + (center[2] - _packet.oz[i]) * nz;
+		double dot_nd = nx * _packet.dx[i] + ny * _packet.dy[i] + nz * _packet.dz[i];
+		double t = dot_no / dot_nd;
+
+		_hit[i]    = !(dot_nd < 1e-7 && dot_nd > -1e-7) && t > 0 && t <= _hits[i].t;
+		_hits[i].t = _hit[i] ? t : _hits[i].t;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Plane::
+occluded(const Ray& _ray, double _tmax) const
+{
+	return occluded_impl(_ray, _tmax);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Plane::
+occluded(const Rayf& _ray, float _tmax) const
+{
+	return occluded_impl(_ray, _tmax);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+bool
+Plane::
+occluded_impl(const RayT<Scalar>& _ray, Scalar _tmax) const
+{
+	const Vec3T<Scalar> c(center), n(normal);
+	Scalar dot_nd = dot(n, _ray.direction);
+	if (dot_nd < Scalar(1e-7) && dot_nd > Scalar(-1e-7))
+		return false;
+	Scalar t = dot((c - _ray.origin), n) / dot_nd;
+	return (t > 0 && t < _tmax);
+}
+
+
 //=============================================================================
@@ -0,0 +1,367 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "PrimitiveArrays.h"
+
+#include "Sphere.h"
+#include "Cylinder.h"
+#include "Plane.h"
+#include "Statistics.h"
+
+#include <algorithm>
+#include <limits>
+#include <typeinfo>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+/// Spheres per leaf of the sphere BVH, a multiple of the number of lanes of
+/// intersect_sphere_lanes(). Large leaves make better use of the batches,
+/// the hierarchy still culls most spheres.
+static const int sphere_leaf_size = 8;
+
+/// Spheres added at the end of the sphere arrays, such that
+/// intersect_sphere_lanes() can always load a full batch.
+static const int sphere_padding = 7;
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Build \c _bvh over the bounding boxes of \c _objects with at most
+/// \c _max_leaf_size objects per leaf and split algorithm \c _method, then
+/// reorder \c _objects and their scene indices \c _indices into its leaf order.
+template <class T>
+static void build_leaf_order(BVH& _bvh, std::vector<const T*>& _objects, std::vector<int>& _indices,
+                             int _max_leaf_size, BVH::Method _method)
+{
+    const size_t n = _objects.size();
+
+    std::vector<vec3> bb_min(n), bb_max(n);
+    for (size_t i = 0; i < n; ++i)
+        _objects[i]->bounds(bb_min[i], bb_max[i]);
+    _bvh.build(bb_min, bb_max, _max_leaf_size, _method);
+
+    std::vector<const T*> objects(n);
+    std::vector<int>      indices(n);
+    for (int p = 0; p < _bvh.size(); ++p)
+    {
+        objects[p] = _objects[_bvh.primitive(p)];
+        indices[p] = _indices[_bvh.primitive(p)];
+    }
+    _objects.swap(objects);
+    _indices.swap(indices);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void PrimitiveArrays::clear()
+{
+    spheres_.clear();
+    cylinders_.clear();
+    planes_.clear();
+    sphere_objects_.clear();
+    cylinder_objects_.clear();
+    plane_objects_.clear();
+    build();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool PrimitiveArrays::add(const Object* _object, int _index)
+{
+    if (typeid(*_object) == typeid(Sphere))
+    {
+        spheres_.push_back(static_cast<const Sphere*>(_object));
+        sphere_objects_.push_back(_index);
+        return true;
+    }
+    if (typeid(*_object) == typeid(Cylinder))
+    {
+        cylinders_.push_back(static_cast<const Cylinder*>(_object));
+        cylinder_objects_.push_back(_index);
+        return true;
+    }
+    if (typeid(*_object) == typeid(Plane))
+    {
+        planes_.push_back(static_cast<const Plane*>(_object));
+        plane_objects_.push_back(_index);
+        return true;
+    }
+    return false;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void PrimitiveArrays::build(BVH::Method _method)
+{
+    build_leaf_order(sphere_bvh_,   spheres_,   sphere_objects_,   sphere_leaf_size, _method);
+    build_leaf_order(cylinder_bvh_, cylinders_, cylinder_objects_, 4,                _method);
+
+    fill_arrays(arrays_);
+    fill_arrays(arrays_float_);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+void PrimitiveArrays::fill_arrays(Arrays<Scalar>& _arrays) const
+{
+    _arrays = Arrays<Scalar>();
+
+    static_assert(sphere_padding >= SphereLanes<Scalar>::value - 1, "sphere arrays are not padded enough");
+
+    SphereArrays<Scalar>& s = _arrays.spheres;
+    for (const Sphere* sphere: spheres_)
+    {
+        for (int c = 0; c < 3; ++c)
+            s.center[c].push_back(Scalar(sphere->center[c]));
+        s.radius.push_back(Scalar(sphere->radius));
+    }
+    for (int c = 0; c < 3; ++c)
+        s.center[c].resize(s.center[c].size() + sphere_padding, Scalar(0));
+    s.radius.resize(s.radius.size() + sphere_padding, Scalar(0));
+
+    // the half height is computed like in Cylinder::intersect()
+    CylinderArrays<Scalar>& cy = _arrays.cylinders;
+    for (const Cylinder* cylinder: cylinders_)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            cy.center[c].push_back(Scalar(cylinder->center[c]));
+            cy.axis[c]  .push_back(Scalar(cylinder->axis[c]));
+        }
+        cy.radius.push_back(Scalar(cylinder->radius));
+        cy.half_height.push_back(Scalar(cylinder->height / 2));
+    }
+
+    PlaneArrays<Scalar>& p = _arrays.planes;
+    for (const Plane* plane: planes_)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            p.center[c].push_back(Scalar(plane->center[c]));
+            p.normal[c].push_back(Scalar(plane->normal[c]));
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <>
+const PrimitiveArrays::Arrays<double>& PrimitiveArrays::arrays<double>() const
+{
+    return arrays_;
+}
+
+template <>
+const PrimitiveArrays::Arrays<float>& PrimitiveArrays::arrays<float>() const
+{
+    return arrays_float_;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+void PrimitiveArrays::nearest_sphere(int _begin, int _end, const Scalar* _o, const Scalar* _d,
+                                     int& _object, Scalar& _t) const
+{
+    const int LANES = SphereLanes<Scalar>::value;
+    const SphereArrays<Scalar>& s = arrays<Scalar>().spheres;
+    Scalar t[LANES];
+
+    for (int first = _begin; first < _end; first += LANES)
+    {
+        intersect_sphere_lanes(s, first, _o, _d, t);
+
+        // ties are resolved by object index, see intersect()
+        for (int k = 0; k < LANES && first + k < _end; ++k)
+        {
+            const int object = sphere_objects_[first + k];
+            if (t[k] < _t || (t[k] == _t && object < _object))
+            {
+                _t      = t[k];
+                _object = object;
+            }
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+void PrimitiveArrays::intersect(const RayT<Scalar>& _ray, int& _object, Scalar& _t) const
+{
+    const Arrays<Scalar>& a = arrays<Scalar>();
+    const Scalar o[3] = { _ray.origin[0],    _ray.origin[1],    _ray.origin[2] };
+    const Scalar d[3] = { _ray.direction[0], _ray.direction[1], _ray.direction[2] };
+
+    // keep the closer intersection, ties are resolved by object index
+    auto update = [&](Scalar _ti, int _oi)
+    {
+        if (_ti < _t || (_ti == _t && _oi < _object))
+        {
+            _t      = _ti;
+            _object = _oi;
+        }
+    };
+
+    int tests = int(plane_objects_.size());
+    for (size_t i = 0; i < plane_objects_.size(); ++i)
+        update(intersect_plane(a.planes, int(i), o, d), plane_objects_[i]);
+
+    // _t is also the traversal bound, so closer hits cull farther nodes
+    sphere_bvh_.traverse_leaves(_ray, _t, [&](int _begin, int _end, Scalar&)
+    {
+        tests += _end - _begin;
+        nearest_sphere(_begin, _end, o, d, _object, _t);
+        return false;
+    });
+
+    cylinder_bvh_.traverse_leaves(_ray, _t, [&](int _begin, int _end, Scalar&)
+    {
+        tests += _end - _begin;
+        for (int i = _begin; i < _end; ++i)
+            update(intersect_cylinder(a.cylinders, i, o, d), cylinder_objects_[i]);
+        return false;
+    });
+
+    Statistics::count(Statistics::OBJECT_TESTS, tests);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void PrimitiveArrays::intersect_packet(const RayPacket& _packet, int* _object, double* _t) const
+{
+    const Arrays<double>& a = arrays_;
+
+    double o[RayPacket::MAX_SIZE][3], d[RayPacket::MAX_SIZE][3];
+    for (int k = 0; k < _packet.size; ++k)
+    {
+        o[k][0] = _packet.ox[k];  o[k][1] = _packet.oy[k];  o[k][2] = _packet.oz[k];
+        d[k][0] = _packet.dx[k];  d[k][1] = _packet.dy[k];  d[k][2] = _packet.dz[k];
+    }
+
+    // same tie breaking as in intersect()
+    auto update = [&](int _k, double _ti, int _oi)
+    {
+        if (_ti < _t[_k] || (_ti == _t[_k] && _oi < _object[_k]))
+        {
+            _t[_k]      = _ti;
+            _object[_k] = _oi;
+        }
+    };
+
+    int tests = int(plane_objects_.size()) * _packet.size;
+    for (size_t i = 0; i < plane_objects_.size(); ++i)
+        for (int k = 0; k < _packet.size; ++k)
+            update(k, intersect_plane(a.planes, int(i), o[k], d[k]), plane_objects_[i]);
+
+    sphere_bvh_.traverse_leaves(_packet, _t, [&](int _begin, int _end)
+    {
+        tests += (_end - _begin) * _packet.size;
+        for (int k = 0; k < _packet.size; ++k)
+            nearest_sphere(_begin, _end, o[k], d[k], _object[k], _t[k]);
+    });
+
+    cylinder_bvh_.traverse_leaves(_packet, _t, [&](int _begin, int _end)
+    {
+        tests += (_end - _begin) * _packet.size;
+        for (int i = _begin; i < _end; ++i)
+            for (int k = 0; k < _packet.size; ++k)
+                update(k, intersect_cylinder(a.cylinders, i, o[k], d[k]), cylinder_objects_[i]);
+    });
+
+    Statistics::count(Statistics::OBJECT_TESTS, tests);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+bool PrimitiveArrays::occluded(const RayT<Scalar>& _ray, Scalar _tmax) const
+{
+    const Arrays<Scalar>& a = arrays<Scalar>();
+    const Scalar o[3] = { _ray.origin[0],    _ray.origin[1],    _ray.origin[2] };
+    const Scalar d[3] = { _ray.direction[0], _ray.direction[1], _ray.direction[2] };
+
+    // For spheres and planes, the closest intersection with t > 0 is in
+    // (0, _tmax) if and only if any intersection is.
+    for (size_t i = 0; i < plane_objects_.size(); ++i)
+        if (intersect_plane(a.planes, int(i), o, d) < _tmax)
+        {
+            Statistics::count(Statistics::OBJECT_TESTS, i + 1);
+            return true;
+        }
+
+    int  tests = int(plane_objects_.size());
+    bool hit   = false;
+    sphere_bvh_.traverse_leaves(_ray, _tmax, [&](int _begin, int _end, Scalar&)
+    {
+        const int LANES = SphereLanes<Scalar>::value;
+        Scalar    t[LANES];
+        for (int first = _begin; first < _end && !hit; first += LANES)
+        {
+            intersect_sphere_lanes(a.spheres, first, o, d, t);
+            tests += std::min(LANES, _end - first);
+            for (int k = 0; k < LANES && first + k < _end; ++k)
+                hit = hit || (t[k] < _tmax);
+        }
+        return hit;
+    });
+
+    if (!hit)
+    {
+        cylinder_bvh_.traverse_leaves(_ray, _tmax, [&](int _begin, int _end, Scalar&)
+        {
+            for (int i = _begin; i < _end && !hit; ++i)
+            {
+                ++tests;
+                hit = occluded_cylinder(a.cylinders, i, o, d, _tmax);
+            }
+            return hit;
+        });
+    }
+
+    Statistics::count(Statistics::OBJECT_TESTS, tests);
+    return hit;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template void PrimitiveArrays::intersect(const RayT<double>&, int&, double&) const;
+template void PrimitiveArrays::intersect(const RayT<float>&,  int&, float&)  const;
+template bool PrimitiveArrays::occluded(const RayT<double>&, double) const;
+template bool PrimitiveArrays::occluded(const RayT<float>&,  float)  const;
+
+
+//=============================================================================
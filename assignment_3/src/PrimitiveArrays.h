@@ -0,0 +1,343 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef PRIMITIVEARRAYS_H
+#define PRIMITIVEARRAYS_H
+
+
+//== INCLUDES =================================================================
+
+#include "Object.h"
+#include "BVH.h"
+#include "SolveQuadratic.h"
+#include "Ray.h"
+#include "RayPacket.h"
+
+#include <array>
+#include <limits>
+#include <vector>
+
+
+class Sphere;
+class Cylinder;
+class Plane;
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class PrimitiveArrays PrimitiveArrays.h
+/// This class stores the scene objects of the built-in types Sphere,
+/// Cylinder, and Plane grouped by type, with the parameters of each type as
+/// structure of arrays (one array per coordinate). Instead of a virtual call
+/// per object, the objects of a type are intersected by a loop over these
+/// arrays with the intersection test inlined. Spheres and cylinders each have
+/// their own BVH, and their arrays are stored in its leaf order, such that
+/// every leaf is a contiguous range. Planes are unbounded and tested
+/// linearly. Spheres, which make up most of molecule-like scenes, are tested
+/// in batches of 4 (double) or 8 (float) per ray with SIMD. Like Mesh, the
+/// arrays are kept in double and in single precision.
+///
+/// The loops compute the same ray parameters as the intersect() and
+/// occluded() functions of the objects. Objects of other types, including
+/// user-defined ones, are not stored here and are still handled through the
+/// virtual Object interface by Scene.
+class PrimitiveArrays
+{
+public:
+
+    /// Remove all objects.
+    void clear();
+
+    /// Add \c _object, which has index \c _index in Scene::objects, if it is
+    /// a Sphere, Cylinder, or Plane, but not of a subclass, which may
+    /// override intersect(). Return whether it was added.
+    /// build() has to be called after all objects were added.
+    bool add(const Object* _object, int _index);
+
+    /// Build the hierarchies with split algorithm \c _method and fill the
+    /// arrays of the added objects.
+    void build(BVH::Method _method = BVH::SAH);
+
+    /// Find the closest intersection of \c _ray with the stored objects.
+    /// On input, \c _object and \c _t are the closest intersection found so
+    /// far (or -1 and infinity). They are replaced by an intersection with
+    /// a smaller ray parameter, or with the same parameter and a smaller
+    /// object index, see Scene::intersect().
+    template <class Scalar>
+    void intersect(const RayT<Scalar>& _ray, int& _object, Scalar& _t) const;
+
+    /// Closest intersections for all rays of \c _packet, with the same
+    /// semantics per lane as intersect().
+    void intersect_packet(const RayPacket& _packet, int* _object, double* _t) const;
+
+    /// Does any stored object intersect \c _ray at a ray parameter in
+    /// (0, \c _tmax)?
+    template <class Scalar>
+    bool occluded(const RayT<Scalar>& _ray, Scalar _tmax) const;
+
+public:
+
+    // The intersection kernels and their data layout are public, such that
+    // kernel_bench can measure them on their own.
+
+    /// parameters of the spheres, see Sphere
+    template <class Scalar>
+    struct SphereArrays
+    {
+        /// center
+        std::vector<Scalar> center[3];
+        /// radius
+        std::vector<Scalar> radius;
+    };
+
+    /// parameters of the cylinders, see Cylinder
+    template <class Scalar>
+    struct CylinderArrays
+    {
+        /// center
+        std::vector<Scalar> center[3];
+        /// unit axis vector
+        std::vector<Scalar> axis[3];
+        /// radius
+        std::vector<Scalar> radius;
+        /// half of the height
+        std::vector<Scalar> half_height;
+    };
+
+    /// parameters of the planes, see Plane
+    template <class Scalar>
+    struct PlaneArrays
+    {
+        /// point on the plane
+        std::vector<Scalar> center[3];
+        /// normal vector
+        std::vector<Scalar> normal[3];
+    };
+
+    /// Number of spheres intersected together by intersect_sphere_lanes():
+    /// one AVX register of \c Scalar, i.e., 4 in double and 8 in single precision
+    template <class Scalar>
+    struct SphereLanes { static const int value = 32 / sizeof(Scalar); };
+
+    /// For the spheres at the leaf order positions [\c _first, \c _first +
+    /// SphereLanes<Scalar>::value), store the ray parameter of the closest
+    /// intersection with t > 0 of the ray with origin \c _o and direction
+    /// \c _d in \c _t[k], or infinity. Same computation as
+    /// Sphere::intersect(), written as a branch-free loop over the lanes,
+    /// which the compiler turns into SIMD code.
+    template <class Scalar>
+    static void intersect_sphere_lanes(const SphereArrays<Scalar>& _s, int _first,
+                                       const Scalar* _o, const Scalar* _d, Scalar* _t);
+
+    /// Ray parameter of the closest intersection with t >= 0 of the ray with
+    /// origin \c _o and direction \c _d and cylinder \c _i, or infinity. Same
+    /// computation as Cylinder::intersect().
+    template <class Scalar>
+    static Scalar intersect_cylinder(const CylinderArrays<Scalar>& _c, int _i,
+                                     const Scalar* _o, const Scalar* _d);
+
+    /// Does the ray with origin \c _o and direction \c _d intersect cylinder
+    /// \c _i in (0, \c _tmax)? Same computation as Cylinder::occluded().
+    template <class Scalar>
+    static bool occluded_cylinder(const CylinderArrays<Scalar>& _c, int _i,
+                                  const Scalar* _o, const Scalar* _d, Scalar _tmax);
+
+    /// Ray parameter of the intersection with t > 0 of the ray with origin
+    /// \c _o and direction \c _d and plane \c _i, or infinity. Same
+    /// computation as Plane::intersect().
+    template <class Scalar>
+    static Scalar intersect_plane(const PlaneArrays<Scalar>& _p, int _i,
+                                  const Scalar* _o, const Scalar* _d);
+
+private:
+
+    /// the arrays of all types in precision \c Scalar
+    template <class Scalar>
+    struct Arrays
+    {
+        SphereArrays<Scalar>   spheres;
+        CylinderArrays<Scalar> cylinders;
+        PlaneArrays<Scalar>    planes;
+    };
+
+    /// The arrays of precision \c Scalar
+    template <class Scalar>
+    const Arrays<Scalar>& arrays() const;
+
+    /// Fill \c _arrays from the objects, converting to precision \c Scalar
+    template <class Scalar>
+    void fill_arrays(Arrays<Scalar>& _arrays) const;
+
+    /// Find the closest intersection of the ray with origin \c _o and
+    /// direction \c _d with the spheres at the leaf order positions
+    /// [\c _begin, \c _end), tested in batches by intersect_sphere_lanes().
+    /// \c _object and \c _t are updated like in intersect().
+    template <class Scalar>
+    void nearest_sphere(int _begin, int _end, const Scalar* _o, const Scalar* _d,
+                        int& _object, Scalar& _t) const;
+
+private:
+
+    /// the added objects of each type, reordered like the arrays by build()
+    std::vector<const Sphere*>   spheres_;
+    std::vector<const Cylinder*> cylinders_;
+    std::vector<const Plane*>    planes_;
+
+    /// indices (into Scene::objects) of the objects in spheres_, cylinders_,
+    /// and planes_
+    std::vector<int> sphere_objects_, cylinder_objects_, plane_objects_;
+
+    /// hierarchies over the spheres and the cylinders
+    BVH sphere_bvh_, cylinder_bvh_;
+
+    /// parameters of all objects, in the leaf order of the hierarchies
+    Arrays<double> arrays_;
+
+    /// single precision copy of arrays_
+    Arrays<float> arrays_float_;
+};
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+template <class Scalar>
+inline void PrimitiveArrays::intersect_sphere_lanes(const SphereArrays<Scalar>& _s, int _first,
+                                                    const Scalar* _o, const Scalar* _d, Scalar* _t)
+{
+    const int LANES = SphereLanes<Scalar>::value;
+    const Scalar* cx = &_s.center[0][_first];
+    const Scalar* cy = &_s.center[1][_first];
+    const Scalar* cz = &_s.center[2][_first];
+    const Scalar* r  = &_s.radius[_first];
+
+    const Scalar d_d = _d[0]*_d[0] + _d[1]*_d[1] + _d[2]*_d[2];
+
+    for (int k = 0; k < LANES; ++k)
+    {
+        const Scalar ocx = _o[0] - cx[k];
+        const Scalar ocy = _o[1] - cy[k];
+        const Scalar ocz = _o[2] - cz[k];
+
+        Scalar t0, t1;
+        solveQuadraticSelect(d_d,
+                             2 * (_d[0]*ocx + _d[1]*ocy + _d[2]*ocz),
+                             (ocx*ocx + ocy*ocy + ocz*ocz) - r[k] * r[k],
+                             t0, t1);
+
+        // closest solution in front of the origin
+        Scalar t = std::numeric_limits<Scalar>::infinity();
+        t = ((t0 > 0) && (t0 < t)) ? t0 : t;
+        t = ((t1 > 0) && (t1 < t)) ? t1 : t;
+        _t[k] = t;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+inline Scalar PrimitiveArrays::intersect_cylinder(const CylinderArrays<Scalar>& _c, int _i,
+                                                  const Scalar* _o, const Scalar* _d)
+{
+    const Scalar cx = _c.center[0][_i], cy = _c.center[1][_i], cz = _c.center[2][_i];
+    const Scalar ax = _c.axis[0][_i],   ay = _c.axis[1][_i],   az = _c.axis[2][_i];
+    const Scalar r  = _c.radius[_i],    hh = _c.half_height[_i];
+    const Scalar ocx = _o[0] - cx, ocy = _o[1] - cy, ocz = _o[2] - cz;
+
+    const Scalar d_d   = _d[0]*_d[0] + _d[1]*_d[1] + _d[2]*_d[2];
+    const Scalar d_a   = ax*_d[0] + ay*_d[1] + az*_d[2];
+    const Scalar d_oc  = _d[0]*ocx + _d[1]*ocy + _d[2]*ocz;
+    const Scalar oc_a  = ocx*ax + ocy*ay + ocz*az;
+    const Scalar oc_oc = ocx*ocx + ocy*ocy + ocz*ocz;
+
+    std::array<Scalar, 2> s;
+    const size_t n = solveQuadratic(d_d - d_a * d_a,
+                                    2 * (d_oc - d_a * oc_a),
+                                    oc_oc - oc_a * oc_a - r * r,
+                                    s);
+
+    // closest solution in front of the origin within the height of the cylinder
+    Scalar t = std::numeric_limits<Scalar>::infinity();
+    for (size_t k = 0; k < n; ++k)
+    {
+        const Scalar h = ((_o[0] + s[k]*_d[0]) - cx) * ax
+                       + ((_o[1] + s[k]*_d[1]) - cy) * ay
+                       + ((_o[2] + s[k]*_d[2]) - cz) * az;
+        if (s[k] >= 0 && h < hh && h > -hh && s[k] < t)
+            t = s[k];
+    }
+    return t;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+inline bool PrimitiveArrays::occluded_cylinder(const CylinderArrays<Scalar>& _c, int _i,
+                                               const Scalar* _o, const Scalar* _d, Scalar _tmax)
+{
+    const Scalar cx = _c.center[0][_i], cy = _c.center[1][_i], cz = _c.center[2][_i];
+    const Scalar ax = _c.axis[0][_i],   ay = _c.axis[1][_i],   az = _c.axis[2][_i];
+    const Scalar r  = _c.radius[_i],    hh = _c.half_height[_i];
+    const Scalar ocx = _o[0] - cx, ocy = _o[1] - cy, ocz = _o[2] - cz;
+
+    const Scalar d_d   = _d[0]*_d[0] + _d[1]*_d[1] + _d[2]*_d[2];
+    const Scalar d_a   = _d[0]*ax + _d[1]*ay + _d[2]*az;
+    const Scalar d_oc  = _d[0]*ocx + _d[1]*ocy + _d[2]*ocz;
+    const Scalar oc_a  = ocx*ax + ocy*ay + ocz*az;
+    const Scalar oc_oc = ocx*ocx + ocy*ocy + ocz*ocz;
+
+    std::array<Scalar, 2> s;
+    const size_t n = solveQuadratic(d_d - d_a * d_a,
+                                    2 * (d_oc - d_a * oc_a),
+                                    oc_oc - oc_a * oc_a - r * r,
+                                    s);
+
+    for (size_t k = 0; k < n; ++k)
+    {
+        if (s[k] > 0 && s[k] < _tmax)
+        {
+            const Scalar h = ((_o[0] + s[k]*_d[0]) - cx) * ax
+                           + ((_o[1] + s[k]*_d[1]) - cy) * ay
+                           + ((_o[2] + s[k]*_d[2]) - cz) * az;
+            if (h < hh && h > -hh)
+                return true;
+        }
+    }
+    return false;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+inline Scalar PrimitiveArrays::intersect_plane(const PlaneArrays<Scalar>& _p, int _i,
+                                               const Scalar* _o, const Scalar* _d)
+{
+    const Scalar nx = _p.normal[0][_i], ny = _p.normal[1][_i], nz = _p.normal[2][_i];
+    const Scalar dot_no = (_p.center[0][_i] - _o[0]) * nx
+                        + (_p.center[1][_i] - _o[1]) * ny
+                        + (_p.center[2][_i] - _o[2]) * nz;
+    const Scalar dot_nd = nx * _d[0] + ny * _d[1] + nz * _d[2];
+    const Scalar t = dot_no / dot_nd;
+
+    const bool parallel = dot_nd < Scalar(1e-7) && dot_nd > Scalar(-1e-7);
+    return (!parallel && t > 0) ? t : std::numeric_limits<Scalar>::infinity();
+}
+
+
+//=============================================================================
+#endif // PRIMITIVEARRAYS_H defined
+//=============================================================================
@@ -0,0 +1,295 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+#include "Profiler.h"
+#include "StopWatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <set>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+bool Profiler::enabled = false;
+
+
+namespace {
+
+/// one recorded interval of a scope
+struct Event
+{
+    /// names of the scope and of its parents, outermost first
+    std::vector<std::string> path;
+    /// index of the recording thread, in the order of their first interval
+    int thread;
+    /// start and end in microseconds since the start of the program
+    double start, end;
+};
+
+/// the start of the program, the origin of all times
+const StopWatch::Clock::time_point epoch = StopWatch::Clock::now();
+
+/// microseconds since epoch
+double now_us()
+{
+    return std::chrono::duration<double, std::micro>(StopWatch::Clock::now() - epoch).count();
+}
+
+/// the intervals of all threads that have exited, guarded by events_mutex
+std::vector<Event> events_;
+std::mutex         events_mutex;
+
+/// number of threads that have recorded an interval
+std::atomic<int> num_threads(0);
+
+
+/// The scopes and intervals of one thread, added to events_ when the
+/// thread exits.
+struct ThreadEvents
+{
+    ThreadEvents() : thread(-1) {}
+
+    ~ThreadEvents()
+    {
+        flush();
+    }
+
+    /// add the intervals to events_ and clear them
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        events_.insert(events_.end(), events.begin(), events.end());
+        events.clear();
+    }
+
+    /// index of the thread, assigned at its first interval
+    int id()
+    {
+        if (thread < 0) thread = num_threads++;
+        return thread;
+    }
+
+    /// names of the running scopes
+    std::vector<std::string> path;
+    /// the recorded intervals since the last flush
+    std::vector<Event> events;
+    /// see id()
+    int thread;
+};
+
+thread_local ThreadEvents thread_events;
+
+
+/// all recorded intervals, sorted by start time
+std::vector<Event> recorded_events()
+{
+    thread_events.flush();
+    std::vector<Event> events;
+    {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        events = events_;
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const Event& a, const Event& b) { return a.start < b.start; });
+    return events;
+}
+
+
+/// \c _s as a JSON string
+std::string json_string(const std::string& _s)
+{
+    std::string quoted = "\"";
+    for (char ch: _s)
+    {
+        if (ch == '"' || ch == '\\') quoted += '\\';
+        quoted += ch;
+    }
+    return quoted + "\"";
+}
+
+
+/// A node of the report tree, the intervals of one path.
+struct Node
+{
+    double total_ms = 0;
+    int calls = 0;
+    std::set<int> threads;
+    /// children in the order of their first interval
+    std::vector<std::pair<std::string, Node>> children;
+
+    Node& child(const std::string& _name)
+    {
+        for (auto& c: children)
+            if (c.first == _name) return c.second;
+        children.emplace_back(_name, Node());
+        return children.back().second;
+    }
+};
+
+
+/// print \c _node and its children, indented by \c _depth
+void write_node(std::ostream& _os, const std::string& _name, const Node& _node, int _depth)
+{
+    const std::string label = std::string(2 * _depth, ' ') + _name;
+    _os << std::left  << std::setw(50) << label
+        << std::right << std::setw(12) << _node.total_ms
+        << std::setw(8) << _node.calls
+        << std::setw(8) << _node.threads.size() << "\n";
+    for (const auto& c: _node.children)
+        write_node(_os, c.first, c.second, _depth + 1);
+}
+
+} // namespace
+
+
+//-----------------------------------------------------------------------------
+
+
+Profiler::Scope::Scope(const std::string& _name)
+    : start_(0.0), active_(Profiler::enabled)
+{
+    if (!active_) return;
+    thread_events.path.push_back(_name);
+    start_ = now_us();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Profiler::Scope::Scope(const char* _name)
+    : start_(0.0), active_(Profiler::enabled)
+{
+    if (!active_) return;
+    thread_events.path.push_back(_name);
+    start_ = now_us();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Profiler::Scope::~Scope()
+{
+    if (!active_) return;
+    ThreadEvents& te = thread_events;
+    te.events.push_back(Event{te.path, te.id(), start_, now_us()});
+    te.path.pop_back();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Profiler::Attach::Attach(const std::vector<std::string>& _path)
+    : length_(Profiler::enabled ? _path.size() : 0)
+{
+    if (length_)
+        thread_events.path.insert(thread_events.path.end(), _path.begin(), _path.end());
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Profiler::Attach::~Attach()
+{
+    if (length_)
+        thread_events.path.resize(thread_events.path.size() - length_);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+std::vector<std::string> Profiler::current_path()
+{
+    return thread_events.path;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Profiler::reset()
+{
+    thread_events.events.clear();
+    std::lock_guard<std::mutex> lock(events_mutex);
+    events_.clear();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Profiler::write_report(std::ostream& _os)
+{
+    Node root;
+    for (const Event& e: recorded_events())
+    {
+        Node* node = &root;
+        for (const std::string& name: e.path)
+            node = &node->child(name);
+        node->total_ms += (e.end - e.start) * 1e-3;
+        node->calls    += 1;
+        node->threads.insert(e.thread);
+    }
+
+    const std::ios_base::fmtflags flags = _os.flags();
+    _os << std::left  << std::setw(50) << "scope"
+        << std::right << std::setw(12) << "total ms"
+        << std::setw(8) << "calls"
+        << std::setw(8) << "threads" << "\n"
+        << std::fixed << std::setprecision(3);
+    for (const auto& c: root.children)
+        write_node(_os, c.first, c.second, 0);
+    _os.flags(flags);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Profiler::write_trace(const std::string& _filename)
+{
+    std::ofstream ofs(_filename);
+    if (!ofs) return false;
+
+    // complete events ("X") with start and duration in microseconds; the
+    // path is shown as argument of the event
+    ofs << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::fixed << std::setprecision(3);
+    bool first = true;
+    for (const Event& e: recorded_events())
+    {
+        std::string path;
+        for (const std::string& name: e.path)
+            path += (path.empty() ? "" : " > ") + name;
+
+        ofs << (first ? "\n" : ",\n")
+            << "{\"name\": " << json_string(e.path.back()) << ", \"cat\": \"raytrace\", \"ph\": \"X\""
+            << ", \"ts\": " << e.start << ", \"dur\": " << e.end - e.start
+            << ", \"pid\": 1, \"tid\": " << e.thread
+            << ", \"args\": {\"path\": " << json_string(path) << "}}";
+        first = false;
+    }
+    ofs << "\n]}\n";
+    return bool(ofs);
+}
+
+
+//=============================================================================
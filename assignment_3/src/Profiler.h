@@ -0,0 +1,116 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+
+//== INCLUDES =================================================================
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class Profiler Profiler.h
+/// This class records the wall time of named, nested scopes of the program,
+/// e.g. reading a scene, reading one of its meshes, computing the normals of
+/// the mesh, rendering, and every tile of the rendering. Each scope is
+/// timed by a Scope object on the stack with the steady clock of StopWatch.
+/// The scopes of a thread nest by their lifetime; a worker thread continues
+/// the scope that started it by an Attach object.
+///
+/// The recorded intervals of all threads can be printed as a tree, in
+/// which the times of scopes with the same path are added up, and written
+/// as a trace for the Chrome trace viewer (chrome://tracing or Perfetto),
+/// which shows every interval on a timeline per thread.
+///
+/// Profiling is disabled by default; then a Scope only checks a flag.
+/// Every thread records into its own buffer, which is added to the recorded
+/// intervals when the thread exits.
+class Profiler
+{
+public:
+
+    /// Time the enclosing scope under the name \c _name, as a child of the
+    /// innermost running Scope (or Attach) of the calling thread.
+    class Scope
+    {
+    public:
+        /// Start timing (if profiling is enabled)
+        explicit Scope(const std::string& _name);
+
+        /// Start timing (if profiling is enabled). Unlike the std::string
+        /// version, this costs nothing but a check of a flag if profiling
+        /// is disabled, e.g. for every tile of the image.
+        explicit Scope(const char* _name);
+
+        /// Record the interval
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        /// start time in microseconds since the start of the program
+        double start_;
+        /// was profiling enabled at construction?
+        bool active_;
+    };
+
+    /// Continue the path \c _path (see current_path()) of another thread
+    /// in the calling thread for the lifetime of this object, such that
+    /// its scopes become children of the scope that started the thread.
+    class Attach
+    {
+    public:
+        /// Push \c _path (if profiling is enabled)
+        explicit Attach(const std::vector<std::string>& _path);
+
+        /// Pop the path again
+        ~Attach();
+
+        Attach(const Attach&) = delete;
+        Attach& operator=(const Attach&) = delete;
+
+    private:
+        /// length of the pushed path
+        size_t length_;
+    };
+
+public:
+
+    /// Record scopes? Disabled by default.
+    static bool enabled;
+
+    /// The names of the running scopes of the calling thread, outermost first
+    static std::vector<std::string> current_path();
+
+    /// Discard all recorded intervals. Must not be called while other
+    /// threads are recording.
+    static void reset();
+
+    /// Print the recorded scopes as a tree to \c _os: for every path, the
+    /// total time of all its intervals (added up over all threads), the
+    /// number of intervals, and the number of threads that recorded them.
+    static void write_report(std::ostream& _os);
+
+    /// Write the recorded intervals as Chrome trace events (JSON) to
+    /// \c _filename. Returns false if the file cannot be written.
+    static bool write_trace(const std::string& _filename);
+};
+
+
+//=============================================================================
+#endif // PROFILER_H defined
+//=============================================================================
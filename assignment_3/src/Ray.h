@@ -20,46 +20,108 @@
 //== CLASS DEFINITION =========================================================
 
 
-/// \class Ray Ray.h
+/// \class RayT Ray.h
 /// This class implements a ray, specified by its origin and direction.
 /// It provides a convenient function to compute the point ray(t) at a specific
-/// ray paramter t.
-class Ray
+/// ray paramter t. Like Vec3T, it is templated over the scalar type: Ray is
+/// used throughout the ray tracer, Rayf by the single precision render mode.
+template <class Scalar>
+class RayT
 {
 public:
 
+    /// 3D vector type of origin and direction
+    typedef Vec3T<Scalar> Vec;
+
     /// Constructor with origin and direction. Direction will be normalized.
-    Ray(const vec3& _origin    = vec3(0,0,0),
-        const vec3& _direction = vec3(0,0,1))
+    RayT(const Vec& _origin    = Vec(0,0,0),
+         const Vec& _direction = Vec(0,0,1))
     {
         origin    = _origin;
         direction = normalize(_direction); // normalize direction
+        init();
+    }
+
+    /// Convert a ray with another scalar type. The direction is converted
+    /// as is, such that both rays have the same parameterization.
+    template <class OtherScalar>
+    explicit RayT(const RayT<OtherScalar>& _ray)
+    : origin(_ray.origin), direction(_ray.direction)
+    {
+        init();
+    }
+
+    /// Precompute the reciprocal direction and its signs, which are used by
+    /// intersect_box(). Has to be called whenever \c direction is changed.
+    void init()
+    {
+        for (int i=0; i<3; ++i)
+        {
+            inv_direction[i] = Scalar(1) / direction[i];
+            sign[i]          = (inv_direction[i] < Scalar(0));
+        }
     }
 
     /// Compute the point on the ray at the parameter \c _t, which is
     /// origin + _t*direction.
-    vec3 operator()(double _t) const
+    Vec operator()(Scalar _t) const
     {
         return origin + _t*direction;
     }
+
+    /// Intersect the ray with the axis-aligned box [\c _bb_min, \c _bb_max]
+    /// using the slab method. On input, [\c _tmin, \c _tmax] is the parameter
+    /// interval of interest; on output it is clipped to the interval in which
+    /// the ray is inside the box. Returns whether this interval is non-empty.
+    /// The box corners may be vectors or arrays of any scalar type, their
+    /// coordinates are converted to the scalar type of the ray.
+    template <class BoxVec>
+    bool intersect_box(const BoxVec& _bb_min, const BoxVec& _bb_max,
+                       Scalar& _tmin, Scalar& _tmax) const
+    {
+        for (int i=0; i<3; ++i)
+        {
+            const Scalar t0 = (Scalar((sign[i] ? _bb_max : _bb_min)[i]) - origin[i]) * inv_direction[i];
+            const Scalar t1 = (Scalar((sign[i] ? _bb_min : _bb_max)[i]) - origin[i]) * inv_direction[i];
+
+            // comparisons are written such that NaNs (ray origin on a slab
+            // plane parallel to the ray) do not shrink the interval
+            if (t0 > _tmin) _tmin = t0;
+            if (t1 < _tmax) _tmax = t1;
+        }
+        return _tmin <= _tmax;
+    }
     
     
 public:
     
     /// origin of the ray
-    vec3 origin;
+    Vec origin;
     /// direction of the ray (should be normalized)
-    vec3 direction;
+    Vec direction;
+    /// component-wise reciprocal of the direction, see init()
+    Vec inv_direction;
+    /// sign[i] is 1 if direction[i] is negative, 0 otherwise, see init()
+    int sign[3];
 };
 
 
+/// ray with double precision
+typedef RayT<double> Ray;
+
+/// ray with single precision, used for single precision rendering
+typedef RayT<float> Rayf;
+
+
 //-----------------------------------------------------------------------------
 
 
 /// read ray from stream
-inline std::istream& operator>>(std::istream& is, Ray& r)
+template <class Scalar>
+inline std::istream& operator>>(std::istream& is, RayT<Scalar>& r)
 {
     is >> r.origin >> r.direction;
+    r.init();
     return is;
 }
 
@@ -0,0 +1,113 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef RAYPACKET_H
+#define RAYPACKET_H
+
+
+//== INCLUDES =================================================================
+
+#include "Ray.h"
+#include "vec3.h"
+
+#include <cassert>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class RayPacket RayPacket.h
+/// This class bundles up to MAX_SIZE coherent rays (e.g., the primary rays of
+/// a small block of pixels) that are intersected together. Origins and
+/// directions are additionally stored as structure of arrays, one array per
+/// coordinate, such that the packet intersection routines can be written as
+/// plain loops over the lanes, which the compiler turns into SIMD code.
+class RayPacket
+{
+public:
+
+    /// maximum number of rays in a packet
+    static const int MAX_SIZE = 16;
+
+    /// Construct an empty packet
+    RayPacket() : size(0) {}
+
+    /// Append \c _ray as the next lane of the packet.
+    void push_back(const Ray& _ray)
+    {
+        assert(size < MAX_SIZE);
+        const int i = size++;
+        ray[i] = _ray;
+        ox[i]  = _ray.origin[0];
+        oy[i]  = _ray.origin[1];
+        oz[i]  = _ray.origin[2];
+        dx[i]  = _ray.direction[0];
+        dy[i]  = _ray.direction[1];
+        dz[i]  = _ray.direction[2];
+        ix[i]  = _ray.inv_direction[0];
+        iy[i]  = _ray.inv_direction[1];
+        iz[i]  = _ray.inv_direction[2];
+    }
+
+    /// Does any ray of the packet intersect the axis-aligned box
+    /// [\c _bb_min, \c _bb_max] in its parameter interval [0, \c _tmax[i]]?
+    /// Uses the same slab test as Ray::intersect_box() in every lane.
+    template <class BoxVec>
+    bool intersect_box(const BoxVec& _bb_min, const BoxVec& _bb_max, const double* _tmax) const
+    {
+        const double x0 = _bb_min[0], y0 = _bb_min[1], z0 = _bb_min[2];
+        const double x1 = _bb_max[0], y1 = _bb_max[1], z1 = _bb_max[2];
+
+        int hits = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            double tmin = 0.0, tmax = _tmax[i];
+            slab(x0, x1, ox[i], ix[i], tmin, tmax);
+            slab(y0, y1, oy[i], iy[i], tmin, tmax);
+            slab(z0, z1, oz[i], iz[i], tmin, tmax);
+            hits += (tmin <= tmax);
+        }
+        return hits > 0;
+    }
+
+private:
+
+    /// clip [_tmin, _tmax] against one slab, see Ray::intersect_box()
+    static void slab(double _lo, double _hi, double _o, double _inv,
+                     double& _tmin, double& _tmax)
+    {
+        const double ta = (_lo - _o) * _inv;
+        const double tb = (_hi - _o) * _inv;
+        const double t0 = (_inv < 0.0) ? tb : ta;
+        const double t1 = (_inv < 0.0) ? ta : tb;
+        _tmin = (t0 > _tmin) ? t0 : _tmin;
+        _tmax = (t1 < _tmax) ? t1 : _tmax;
+    }
+
+public:
+
+    /// number of rays in the packet
+    int size;
+
+    /// the rays of the packet
+    Ray ray[MAX_SIZE];
+
+    /// ray origins, one array per coordinate
+    double ox[MAX_SIZE], oy[MAX_SIZE], oz[MAX_SIZE];
+    /// ray directions, one array per coordinate
+    double dx[MAX_SIZE], dy[MAX_SIZE], dz[MAX_SIZE];
+    /// reciprocal ray directions, one array per coordinate
+    double ix[MAX_SIZE], iy[MAX_SIZE], iz[MAX_SIZE];
+};
+
+
+//=============================================================================
+#endif // RAYPACKET_H defined
+//=============================================================================
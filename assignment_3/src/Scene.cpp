@@ -15,58 +15,105 @@
 #include "Sphere.h"
 #include "Cylinder.h"
 #include "Mesh.h"
+#include "Statistics.h"
 
+#include <cmath>
 #include <limits>
 #include <map>
 #include <functional>
 #include <stdexcept>
+#include <type_traits>
 
-#if HAS_TBB
-#include <tbb/tbb.h>
-#include <tbb/parallel_for.h>
-#endif
+//== IMPLEMENTATION ===========================================================
+
+BVH::Method Scene::bvh_method = BVH::SAH;
+
+//-----------------------------------------------------------------------------
+
+/// Distance by which shadow and reflected rays start off the surface, to
+/// avoid intersecting the surface itself. The larger rounding errors of
+/// single precision need a larger offset.
+template <class Scalar> static Scalar surface_offset();
+template <> double surface_offset<double>() { return 1e-5; }
+template <> float  surface_offset<float>()  { return 1e-4f; }
 
 //-----------------------------------------------------------------------------
 
-Image Scene::render()
+template <class Scalar>
+std::vector<Scene::Bounce<Scalar>>& Scene::bounce_stack()
+{
+    // per-thread stack of shade(), kept allocated between calls
+    static thread_local std::vector<Bounce<Scalar>> stack;
+    return stack;
+}
+
+//-----------------------------------------------------------------------------
+
+Image Scene::render(const TileScheduler::Settings& _settings, int _packet_size, Precision _precision)
 {
     // allocate new image.
     Image img(camera.width, camera.height);
 
-    // Function rendering a full column of the image
-    auto raytraceColumn = [&img, this](int x) {
-        for (int y=0; y<int(camera.height); ++y)
+    // Functions rendering a rectangular tile of the image
+    auto raytraceTile = [&img, this](const TileScheduler::Tile& tile) {
+        raytrace_tile<double>(tile, img);
+    };
+    auto raytraceTileSingle = [&img, this](const TileScheduler::Tile& tile) {
+        raytrace_tile<float>(tile, img);
+    };
+
+    // Block of pixels whose primary rays form a packet: 2x2 for 4 rays,
+    // 4x2 for 8 rays, 4x4 for 16 rays.
+    const int packet_size = std::min(_packet_size, int(RayPacket::MAX_SIZE));
+    unsigned int pw = 1, ph = 1;
+    while (int(2 * pw * ph) <= packet_size)
+    {
+        if (pw <= ph) pw *= 2;
+        else          ph *= 2;
+    }
+
+    // Function rendering a tile by tracing packets of coherent primary rays
+    auto raytraceTilePackets = [&img, pw, ph, this](const TileScheduler::Tile& tile) {
+        RayPacket packet;
+        vec3      colors[RayPacket::MAX_SIZE];
+
+        for (unsigned int by=tile.y0; by<tile.y1; by+=ph)
         {
-            Ray ray = camera.primary_ray(x,y);
+            for (unsigned int bx=tile.x0; bx<tile.x1; bx+=pw)
+            {
+                const unsigned int x1 = std::min(bx+pw, tile.x1);
+                const unsigned int y1 = std::min(by+ph, tile.y1);
 
-            // compute color by tracing this ray
-            vec3 color = trace(ray, 0);
+                Statistics::begin_pixels();
+
+                packet.size = 0;
+                for (unsigned int y=by; y<y1; ++y)
+                    for (unsigned int x=bx; x<x1; ++x)
+                        packet.push_back(camera.primary_ray(x,y));
+                Statistics::count(Statistics::PRIMARY_RAYS, packet.size);
 
-            // avoid over-saturation
-            color = min(color, vec3(1, 1, 1));
+                trace_packet(packet, colors);
+                Statistics::end_pixels(bx, by, x1, y1);
 
-            // store pixel color
-            img(x,y) = color;
+                int i = 0;
+                for (unsigned int y=by; y<y1; ++y)
+                    for (unsigned int x=bx; x<x1; ++x)
+                        img.set(x, y, colors[i++]);
+            }
         }
     };
 
-    // If possible, raytrace image columns in parallel. We use TBB if available
-    // and try OpenMP otherwise. Note that OpenMP only works on the latest
-    // clang compilers, so macOS users will probably have the best luck with TBB.
-    // You can install TBB with MacPorts/Homebrew, or from Intel:
-    // https://github.com/01org/tbb/releases
-#if HAS_TBB
-    tbb::parallel_for(tbb::blocked_range<int>(0, camera.width), [&raytraceColumn](const tbb::blocked_range<int> &range) {
-        for (size_t i = range.begin(); i < range.end(); ++i)
-            raytraceColumn(i);
-    });
-#else
-#if defined(_OPENMP)
-#pragma omp parallel for
-#endif
-    for (int x=0; x<int(camera.width); ++x)
-        raytraceColumn(x);
-#endif
+    // Raytrace the tiles in parallel. The scheduler balances the load by
+    // work stealing, since tiles covering detailed meshes take much longer
+    // than tiles covering the background.
+    TileScheduler scheduler(camera.width, camera.height, _settings);
+    if (_precision == SINGLE_PRECISION)
+        scheduler.run(raytraceTileSingle);
+    else if (pw * ph > 1)
+        scheduler.run(raytraceTilePackets);
+    else
+        scheduler.run(raytraceTile);
+    render_statistics = scheduler.statistics();
 
     // Note: compiler will elide copy.
     return img;
@@ -74,25 +121,90 @@ Image Scene::render()
 
 //-----------------------------------------------------------------------------
 
-vec3 Scene::trace(const Ray& _ray, int _depth)
+template <class Scalar>
+void Scene::raytrace_tile(const TileScheduler::Tile& _tile, Image& _img)
+{
+    for (unsigned int y=_tile.y0; y<_tile.y1; ++y)
+    {
+        for (unsigned int x=_tile.x0; x<_tile.x1; ++x)
+        {
+            Statistics::begin_pixels();
+
+            RayT<Scalar> ray(camera.primary_ray(x,y));
+            Statistics::count(Statistics::PRIMARY_RAYS);
+
+            // compute color by tracing this ray
+            Vec3T<Scalar> color = trace(ray, 0);
+            Statistics::end_pixels(x, y, x+1, y+1);
+
+            // store pixel color, over-saturation is handled by the tone
+            // mapping when the image is written
+            _img.set(x, y, color);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+template <class Scalar>
+Vec3T<Scalar> Scene::trace(const RayT<Scalar>& _ray, int _depth)
 {
     // stop if recursion depth (=number of reflections) is too large
-    if (_depth > max_depth) return vec3(0,0,0);
+    if (_depth > max_depth) return Vec3T<Scalar>(0,0,0);
 
     // Find first intersection with an object. If an intersection is found,
-    // it is stored in object, point, normal, and t.
-    Object_ptr  object;
-    vec3        point;
-    vec3        normal;
-    double      t;
-    if (!intersect(_ray, object, point, normal, t))
+    // it is stored in hit, and its point and normal are computed.
+    HitT<Scalar>   hit;
+    Vec3T<Scalar>  point;
+    Vec3T<Scalar>  normal;
+    if (!intersect(_ray, hit))
+    {
+        return Vec3T<Scalar>(background);
+    }
+    surface(_ray, hit, point, normal);
+
+    return shade(_ray, _depth, objects[hit.object].get(), point, normal);
+}
+
+//-----------------------------------------------------------------------------
+
+void Scene::trace_packet(const RayPacket& _packet, vec3* _colors)
+{
+    // primary rays are at depth 0, see trace()
+    if (max_depth < 0)
     {
-        return background;
+        for (int i = 0; i < _packet.size; ++i)
+            _colors[i] = vec3(0,0,0);
+        return;
     }
 
-    // compute local Phong lighting (ambient+diffuse+specular)
-    vec3 color = lighting(point, normal, -_ray.direction, object->material);
+    // find the closest intersections for all rays at once
+    Hit hits[RayPacket::MAX_SIZE];
+    intersect_packet(_packet, hits);
 
+    // Shade each ray on its own, since shadow and reflection rays are no
+    // longer coherent.
+    vec3 point, normal;
+    for (int i = 0; i < _packet.size; ++i)
+    {
+        if (hits[i].object < 0)
+        {
+            _colors[i] = background;
+            continue;
+        }
+
+        surface(_packet.ray[i], hits[i], point, normal);
+        _colors[i] = shade(_packet.ray[i], 0, objects[hits[i].object].get(), point, normal);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+template <class Scalar>
+Vec3T<Scalar> Scene::shade(const RayT<Scalar>& _ray, int _depth, Object_ptr _object,
+                           const Vec3T<Scalar>& _point, const Vec3T<Scalar>& _normal)
+{
+    typedef Vec3T<Scalar> Vec;
 
     /** \todo
      * Compute reflections by recursive ray tracing:
@@ -103,49 +215,218 @@ vec3 Scene::trace(const Ray& _ray, int _depth)
      * - check whether your recursive algorithm reflects the ray `max_depth` times
      */
 
-    double offset_value = 1e-5;
-    vec3 offset_point = point + offset_value * normal;
+    // Follow the chain of reflections iteratively. The local color and
+    // mirror weight of every reflective hit are pushed onto a stack, which
+    // is folded back to front afterwards. This evaluates exactly the same
+    // expressions as the recursive formulation
+    //   color = (1 - mirror) * local + mirror * trace(reflected ray)
+    // without recursion. The product of the mirror weights (throughput)
+    // bounds the contribution of the remaining bounces; once it drops below
+    // min_throughput, they are treated like exceeding max_depth.
+    std::vector<Bounce<Scalar>>& stack = bounce_stack<Scalar>();
+    stack.clear();
+
+    RayT<Scalar> ray    = _ray;
+    Object_ptr   object = _object;
+    Vec          point  = _point;
+    Vec          normal = _normal;
+    Scalar       throughput = 1;
+    Vec          color;
+
+    for (int depth = _depth; ; ++depth)
+    {
+        // compute local Phong lighting (ambient+diffuse+specular)
+        const Vec local = lighting(point, normal, -ray.direction, object->material);
+
+        Scalar reflection_rate = Scalar(object->material.mirror);
+        if (reflection_rate < Scalar(1e-4))
+        {
+            color = local;
+            break;
+        }
+        stack.push_back(Bounce<Scalar>{local, reflection_rate});
 
-    double reflection_rate = object->material.mirror;
-   	if (reflection_rate < 1e-4)
-   		return color;	
+        throughput *= reflection_rate;
+        if (depth + 1 > max_depth || throughput < Scalar(min_throughput))
+        {
+            color = Vec(0,0,0);
+            break;
+        }
 
-    vec3 reflectedDirection = normalize(-mirror(_ray.direction,normal));
-    Ray reflectedRay(offset_point,reflectedDirection);
-	vec3 reflectedColor = trace(reflectedRay,_depth+1);
-	
-	color = (1 - reflection_rate) * color + reflection_rate * reflectedColor;
+        ray = reflected_ray(ray.direction, point, normal);
+        Statistics::count(Statistics::REFLECTION_RAYS);
 
+        HitT<Scalar> hit;
+        if (!intersect(ray, hit))
+        {
+            color = Vec(background);
+            break;
+        }
+        surface(ray, hit, point, normal);
+        object = objects[hit.object].get();
+    }
+
+    // blend the reflections, starting with the last one
+    for (auto b = stack.rbegin(); b != stack.rend(); ++b)
+        color = (1 - b->mirror) * b->color + b->mirror * color;
 
     return color;
 }
 
 //-----------------------------------------------------------------------------
 
-bool Scene::intersect(const Ray& _ray, Object_ptr& _object, vec3& _point, vec3& _normal, double& _t)
+template <class Scalar>
+bool Scene::intersect(const RayT<Scalar>& _ray, HitT<Scalar>& _hit)
+{
+    _hit = HitT<Scalar>();
+
+    // Is the intersection with object i the currently closest one? Ties are
+    // resolved by object index to match the order of the scene file.
+    HitT<Scalar> h;
+    int tests = 0;
+    auto test_object = [&](int i)
+    {
+        ++tests;
+        h = HitT<Scalar>();
+        if (objects[i]->intersect(_ray, h)) // does ray intersect object?
+        {
+            if (h.t < _hit.t || (h.t == _hit.t && i < _hit.object))
+            {
+                _hit        = h;
+                _hit.object = i;
+            }
+        }
+    };
+
+    // spheres, cylinders, and planes first, which have no primitives
+    primitives.intersect(_ray, _hit.object, _hit.t);
+
+    for (int i: unbounded_objects)
+        test_object(i);
+
+    bvh.traverse(_ray, _hit.t, [&](int i, Scalar&)
+    {
+        test_object(bounded_objects[i]);
+        return false;
+    });
+
+    Statistics::count(Statistics::OBJECT_TESTS, tests);
+    Statistics::count_hit(_hit.object);
+
+    return (_hit.object >= 0);
+}
+
+//-----------------------------------------------------------------------------
+
+template <class Scalar>
+void Scene::surface(const RayT<Scalar>& _ray, const HitT<Scalar>& _hit,
+                    Vec3T<Scalar>& _point, Vec3T<Scalar>& _normal) const
 {
-    double  t, tmin(Object::NO_INTERSECTION);
-    vec3    p, n;
+    objects[_hit.object]->surface(_ray, _hit, _point, _normal);
+}
+
+//-----------------------------------------------------------------------------
 
-    for (const auto &o: objects) // for each object
+void Scene::intersect_packet(const RayPacket& _packet, Hit* _hits)
+{
+    int    object[RayPacket::MAX_SIZE];
+    double t[RayPacket::MAX_SIZE];
+    Hit    h[RayPacket::MAX_SIZE];
+    bool   hit[RayPacket::MAX_SIZE];
+
+    for (int k = 0; k < _packet.size; ++k)
     {
-        if (o->intersect(_ray, p, n, t)) // does ray intersect object?
+        object[k] = -1;
+        t[k]      = Object::NO_INTERSECTION;
+    }
+
+    // spheres, cylinders, and planes first, which have no primitives
+    primitives.intersect_packet(_packet, object, t);
+
+    for (int k = 0; k < _packet.size; ++k)
+    {
+        _hits[k]        = Hit();
+        _hits[k].t      = t[k];
+        _hits[k].object = object[k];
+    }
+
+    // same tie breaking as in the single ray version of intersect(); t
+    // mirrors the ray parameters of _hits for the traversal
+    int tests = 0;
+    auto test_object = [&](int i)
+    {
+        tests += _packet.size;
+        for (int k = 0; k < _packet.size; ++k)
+        {
+            h[k]   = Hit();
+            h[k].t = _hits[k].t;
+        }
+
+        objects[i]->intersect_packet(_packet, h, hit);
+
+        for (int k = 0; k < _packet.size; ++k)
         {
-            if (t < tmin) // is intersection point the currently closest one?
+            if (hit[k] && (h[k].t < _hits[k].t || _hits[k].object < 0 || i < _hits[k].object))
             {
-                tmin = t;
-                _object = o.get();
-                _point  = p;
-                _normal = n;
-                _t      = t;
+                _hits[k]        = h[k];
+                _hits[k].object = i;
+                t[k]            = h[k].t;
             }
         }
+    };
+
+    for (int i: unbounded_objects)
+        test_object(i);
+
+    bvh.traverse(_packet, t, [&](int i)
+    {
+        test_object(bounded_objects[i]);
+    });
+
+    Statistics::count(Statistics::OBJECT_TESTS, tests);
+    for (int k = 0; k < _packet.size; ++k)
+        Statistics::count_hit(_hits[k].object);
+}
+
+//-----------------------------------------------------------------------------
+
+template <class Scalar>
+bool Scene::occluded(const RayT<Scalar>& _ray, Scalar _tmax)
+{
+    Statistics::count(Statistics::SHADOW_RAYS);
+
+    if (primitives.occluded(_ray, _tmax))
+        return true;
+
+    int tests = 0;
+    for (int i: unbounded_objects)
+    {
+        ++tests;
+        if (objects[i]->occluded(_ray, _tmax))
+        {
+            Statistics::count(Statistics::OBJECT_TESTS, tests);
+            return true;
+        }
     }
 
-    return (tmin != Object::NO_INTERSECTION);
+    bool hit = false;
+    bvh.traverse(_ray, _tmax, [&](int i, Scalar&)
+    {
+        ++tests;
+        hit = objects[bounded_objects[i]]->occluded(_ray, _tmax);
+        return hit;
+    });
+
+    Statistics::count(Statistics::OBJECT_TESTS, tests);
+
+    return hit;
 }
 
-vec3 Scene::lighting(const vec3& _point, const vec3& _normal, const vec3& _view, const Material& _material)
+//-----------------------------------------------------------------------------
+
+template <class Scalar>
+Vec3T<Scalar> Scene::lighting(const Vec3T<Scalar>& _point, const Vec3T<Scalar>& _normal,
+                              const Vec3T<Scalar>& _view, const Material& _material)
 {
 
      /** \todo
@@ -159,31 +440,18 @@ vec3 Scene::lighting(const vec3& _point, const vec3& _normal, const vec3& _view,
      */
 
     //ambient
-    vec3 color = ambience * _material.ambient;
+    Vec3T<Scalar> color = Vec3T<Scalar>(ambience) * Vec3T<Scalar>(_material.ambient);
 
     //diffuse & specular
-    Object_ptr o;
-    vec3 p, n;
-    double t;
-
-    double offset_value = 1e-5;
-    vec3 offset_point = _point + offset_value * _normal;
-
-    for(Light light : lights) {
-        
-        Ray r(light.position, offset_point - light.position);
-    	double ray_length = norm(offset_point - light.position);
-    	if (intersect(r, o, p, n, t)) {
-    		if (t > 0 && t < ray_length)
-    			continue;
-    	} //if shadow, discard
-
-        if(dot(normalize(_normal), normalize(light.position-_point))>=0){
-    	vec3 diffuse_color = light.color * _material.diffuse * dot(normalize(_normal), normalize(light.position-_point));
-        vec3 specular_color = light.color * _material.specular * pow(dot(normalize(mirror(light.position-_point, _normal)),_view),_material.shininess);
-    	
-        color+=(diffuse_color+specular_color);
-        }
+    for(const Light& light : lights) {
+
+        Scalar ray_length;
+        RayT<Scalar> r = shadow_ray(light, _point, _normal, ray_length);
+        if (occluded(r, ray_length))
+            continue; //if shadow, discard
+
+        if (faces_light(light, _point, _normal))
+            color += direct_light(light, _point, _normal, _view, _material);
     }
 
 
@@ -196,6 +464,64 @@ vec3 Scene::lighting(const vec3& _point, const vec3& _normal, const vec3& _view,
 
 //-----------------------------------------------------------------------------
 
+template <class Scalar>
+RayT<Scalar> Scene::reflected_ray(const Vec3T<Scalar>& _direction, const Vec3T<Scalar>& _point,
+                                  const Vec3T<Scalar>& _normal) const
+{
+    Scalar offset_value = surface_offset<Scalar>();
+    Vec3T<Scalar> offset_point = _point + offset_value * _normal;
+    Vec3T<Scalar> reflectedDirection = normalize(-mirror(_direction, _normal));
+    return RayT<Scalar>(offset_point, reflectedDirection);
+}
+
+//-----------------------------------------------------------------------------
+
+template <class Scalar>
+RayT<Scalar> Scene::shadow_ray(const Light& _light, const Vec3T<Scalar>& _point,
+                               const Vec3T<Scalar>& _normal, Scalar& _tmax) const
+{
+    // start the ray at the light, such that it can be tested against the
+    // point moved slightly off the surface
+    Scalar offset_value = surface_offset<Scalar>();
+    Vec3T<Scalar> offset_point = _point + offset_value * _normal;
+    Vec3T<Scalar> light_position(_light.position);
+
+    _tmax = norm(offset_point - light_position);
+
+    // In single precision, the rounding error of an intersection grows with
+    // its distance to the ray origin. Rays from a distant light would then
+    // hit the surface they are meant to reach (shadow acne), so they start
+    // at the surface point and go towards the light instead.
+    if (std::is_same<Scalar, float>::value)
+        return RayT<Scalar>(offset_point, light_position - offset_point);
+
+    return RayT<Scalar>(light_position, offset_point - light_position);
+}
+
+//-----------------------------------------------------------------------------
+
+template <class Scalar>
+bool Scene::faces_light(const Light& _light, const Vec3T<Scalar>& _point, const Vec3T<Scalar>& _normal) const
+{
+    return dot(normalize(_normal), normalize(Vec3T<Scalar>(_light.position)-_point)) >= 0;
+}
+
+//-----------------------------------------------------------------------------
+
+template <class Scalar>
+Vec3T<Scalar> Scene::direct_light(const Light& _light, const Vec3T<Scalar>& _point, const Vec3T<Scalar>& _normal,
+                                  const Vec3T<Scalar>& _view, const Material& _material) const
+{
+    typedef Vec3T<Scalar> Vec;
+    const Vec light_position(_light.position), light_color(_light.color);
+    Vec diffuse_color = light_color * Vec(_material.diffuse) * dot(normalize(_normal), normalize(light_position-_point));
+    Vec specular_color = light_color * Vec(_material.specular) * std::pow(dot(normalize(mirror(light_position-_point, _normal)),_view),Scalar(_material.shininess));
+
+    return diffuse_color + specular_color;
+}
+
+//-----------------------------------------------------------------------------
+
 void Scene::read(const std::string &_filename)
 {
     std::ifstream ifs(_filename);
@@ -226,7 +552,68 @@ void Scene::read(const std::string &_filename)
             throw std::runtime_error("Invalid token encountered: " + token);
         entityParser.at(token)();
     }
+
+    build_bvh();
+}
+
+//-----------------------------------------------------------------------------
+
+void Scene::build_bvh()
+{
+    primitives.clear();
+    bounded_objects.clear();
+    unbounded_objects.clear();
+
+    std::vector<vec3> bb_min, bb_max;
+    vec3 omin, omax;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if (primitives.add(objects[i].get(), int(i)))
+            continue;
+
+        if (objects[i]->bounds(omin, omax))
+        {
+            bounded_objects.push_back(int(i));
+            bb_min.push_back(omin);
+            bb_max.push_back(omax);
+        }
+        else
+        {
+            unbounded_objects.push_back(int(i));
+        }
+    }
+
+    Statistics::PhaseTimer timer(Statistics::BUILD);
+    primitives.build(bvh_method);
+    bvh.build(bb_min, bb_max, 4, bvh_method);
 }
 
 
+//-----------------------------------------------------------------------------
+
+// instantiate the ray tracing functions for double and single precision
+#define SCENE_INSTANTIATE(Scalar) \
+    template Vec3T<Scalar> Scene::trace(const RayT<Scalar>&, int); \
+    template Vec3T<Scalar> Scene::shade(const RayT<Scalar>&, int, Object_ptr, \
+                                        const Vec3T<Scalar>&, const Vec3T<Scalar>&); \
+    template bool Scene::intersect(const RayT<Scalar>&, HitT<Scalar>&); \
+    template void Scene::surface(const RayT<Scalar>&, const HitT<Scalar>&, \
+                                 Vec3T<Scalar>&, Vec3T<Scalar>&) const; \
+    template bool Scene::occluded(const RayT<Scalar>&, Scalar); \
+    template Vec3T<Scalar> Scene::lighting(const Vec3T<Scalar>&, const Vec3T<Scalar>&, \
+                                           const Vec3T<Scalar>&, const Material&); \
+    template RayT<Scalar> Scene::reflected_ray(const Vec3T<Scalar>&, const Vec3T<Scalar>&, \
+                                               const Vec3T<Scalar>&) const; \
+    template RayT<Scalar> Scene::shadow_ray(const Light&, const Vec3T<Scalar>&, \
+                                            const Vec3T<Scalar>&, Scalar&) const; \
+    template bool Scene::faces_light(const Light&, const Vec3T<Scalar>&, const Vec3T<Scalar>&) const; \
+    template Vec3T<Scalar> Scene::direct_light(const Light&, const Vec3T<Scalar>&, const Vec3T<Scalar>&, \
+                                               const Vec3T<Scalar>&, const Material&) const;
+
+SCENE_INSTANTIATE(double)
+SCENE_INSTANTIATE(float)
+
+#undef SCENE_INSTANTIATE
+
+
 //=============================================================================
\ No newline at end of file
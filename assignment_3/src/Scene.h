@@ -20,6 +20,9 @@
 #include "Material.h"
 #include "Image.h"
 #include "Camera.h"
+#include "BVH.h"
+#include "PrimitiveArrays.h"
+#include "TileScheduler.h"
 
 #include <memory>
 #include <string>
@@ -31,32 +34,97 @@
 /// objects
 class Scene {
 public:
+    /// Floating point precision used for ray tracing by render()
+    enum Precision {SINGLE_PRECISION, DOUBLE_PRECISION};
+
     /// Constructor loads scene from file.
     Scene(const std::string &path) {
         read(path);
     }
 
-    /// Allocate image and raytrace the scene.
-    Image  render();
+    /// Allocate image and raytrace the scene. The image is split into tiles
+    /// that are distributed over all cores by a TileScheduler.
+    /// \param[in] _settings tile size, tile order, and number of threads
+    /// \param[in] _packet_size number of primary rays traced together as a
+    /// RayPacket (1, 2, 4, 8, or 16); 1 traces every ray on its own
+    /// \param[in] _precision trace rays in single or double precision. The
+    /// scene data is kept in double precision and converted on the fly.
+    /// Single precision always traces every ray on its own.
+    Image  render(const TileScheduler::Settings& _settings = TileScheduler::Settings(),
+                  int _packet_size = 1,
+                  Precision _precision = DOUBLE_PRECISION);
 
     /// Determine the color seen by a viewing ray
     /**
     *   @param[in] _ray passed Ray
-    *   @param[in] _depth holds the information, how many times the `_ray` had been reflected. Goes from 0 to max_depth. Should be used for recursive function call.
+    *   @param[in] _depth holds the information, how many times the `_ray` had been reflected. Goes from 0 to max_depth.
     *   @return    color
     **/ 
-    vec3  trace(const Ray& _ray, int _depth);
+    template <class Scalar>
+    Vec3T<Scalar> trace(const RayT<Scalar>& _ray, int _depth);
+
+    /// Determine the colors seen by the primary rays of \c _packet.
+    /// The closest objects are found for all rays together, shading and
+    /// reflections are computed for each ray on its own.
+    /**
+    *   @param[in]  _packet coherent primary rays
+    *   @param[out] _colors one color per ray of the packet
+    **/
+    void  trace_packet(const RayPacket& _packet, vec3* _colors);
 
-    /// Computes the closest intersection point between a ray and all objects in the scene.
+    /// Determine the color at an intersection point found by a ray,
+    /// including all reflections, which are followed iteratively
+    /**
+    *   @param[in] _ray the ray that hit the object
+    *   @param[in] _depth number of reflections of `_ray`, see trace()
+    *   @param[in] _object the object hit by `_ray`
+    *   @param[in] _point the intersection point
+    *   @param[in] _normal the surface normal at `_point`
+    *   @return    color
+    **/
+    template <class Scalar>
+    Vec3T<Scalar> shade(const RayT<Scalar>& _ray, int _depth, Object_ptr _object,
+                        const Vec3T<Scalar>& _point, const Vec3T<Scalar>& _normal);
+
+    /// Computes the closest intersection between a ray and all objects in the scene.
+    /// Only the ray parameter, the object, and the primitive and barycentric
+    /// coordinates (if any) are determined; point and normal are computed
+    /// afterwards by surface(), once for the closest intersection only.
     /**
     *       @param _ray Ray that should be tested for intersections with all objects in the scene.
-    *       @param _Object_ptr Output parameter which holds the object from the scene, intersected by the `_ray`, closest to the `_ray`'s origin.
+    *       @param _hit Output parameter which holds the closest intersection, see HitT. `_hit.object` is the index into `objects`.
+    *       @return returns `true`, if there is an intersection point between `_ray` and at least one object in the scene.
+    **/
+    template <class Scalar>
+    bool  intersect(const RayT<Scalar>& _ray, HitT<Scalar>& _hit);
+
+    /// Computes intersection point and normal of an intersection found by intersect().
+    /**
+    *       @param _ray the ray passed to intersect()
+    *       @param _hit the intersection found by intersect()
     *       @param _point returns intersection point
     *       @param _normal returns normal at `_point`
-    *       @param _t returns distance between the `_ray`'s origin and `_point`
-    *       @return returns `true`, if there is an intersection point between `_ray` and at least one object in the scene.
     **/
-    bool  intersect(const Ray& _ray, Object_ptr&, vec3& _point, vec3& _normal, double& _t);
+    template <class Scalar>
+    void  surface(const RayT<Scalar>& _ray, const HitT<Scalar>& _hit,
+                  Vec3T<Scalar>& _point, Vec3T<Scalar>& _normal) const;
+
+    /// Computes the closest intersections of the rays of a packet.
+    /**
+    *       @param _packet Rays that should be tested for intersections with all objects in the scene.
+    *       @param _hits Output array: closest intersection of each ray, `object` is -1 if there is none. Point and normal are computed by surface().
+    **/
+    void  intersect_packet(const RayPacket& _packet, Hit* _hits);
+
+    /// Checks whether any object in the scene blocks a ray segment. Used for
+    /// shadow rays, it stops at the first occluder found.
+    /**
+    *       @param _ray Ray that should be tested for intersections with all objects in the scene.
+    *       @param _tmax only intersections with ray parameter in (0, `_tmax`) count
+    *       @return returns `true`, if at least one object is hit in that interval.
+    **/
+    template <class Scalar>
+    bool  occluded(const RayT<Scalar>& _ray, Scalar _tmax);
 
     /// Computes the phong lighting for a given object intersection
     /**
@@ -65,17 +133,84 @@ public:
     *   @param _view normalized direction from the point to the viewer's position.
     *   @param _material holds material parameters of the `_point`, that should be lit.
     */
-    vec3  lighting(const vec3& _point, const vec3& _normal, const vec3& _view, const Material& _material);
+    template <class Scalar>
+    Vec3T<Scalar> lighting(const Vec3T<Scalar>& _point, const Vec3T<Scalar>& _normal,
+                           const Vec3T<Scalar>& _view, const Material& _material);
+
+    /// Reflection of a ray with direction \c _direction at \c _point with
+    /// normal \c _normal, starting slightly off the surface
+    template <class Scalar>
+    RayT<Scalar> reflected_ray(const Vec3T<Scalar>& _direction, const Vec3T<Scalar>& _point,
+                               const Vec3T<Scalar>& _normal) const;
+
+    /// Shadow ray from \c _light to the surface point \c _point with normal
+    /// \c _normal. The point is lit if no object intersects the ray in (0, \c _tmax).
+    template <class Scalar>
+    RayT<Scalar> shadow_ray(const Light& _light, const Vec3T<Scalar>& _point,
+                            const Vec3T<Scalar>& _normal, Scalar& _tmax) const;
+
+    /// Is \c _light on the front side of the surface at \c _point?
+    template <class Scalar>
+    bool  faces_light(const Light& _light, const Vec3T<Scalar>& _point, const Vec3T<Scalar>& _normal) const;
+
+    /// Diffuse and specular contribution of the unoccluded light \c _light
+    /// to the color at \c _point, see lighting()
+    template <class Scalar>
+    Vec3T<Scalar> direct_light(const Light& _light, const Vec3T<Scalar>& _point, const Vec3T<Scalar>& _normal,
+                               const Vec3T<Scalar>& _view, const Material& _material) const;
 
     void read(const std::string &filename);
 
+    /// Store spheres, cylinders, and planes in the type-segregated arrays of
+    /// `primitives`, and build the bounding volume hierarchy over all other
+    /// bounded objects. Other objects without bounding box are kept in a
+    /// separate list.
+    void build_bvh();
+
+    /// Split algorithm of the hierarchies over the objects built by
+    /// build_bvh() (SAH by default). Meshes use Mesh::bvh_method.
+    static BVH::Method bvh_method;
+
     size_t numObjects() const { return objects.size(); }
 
     // Accessors for scene objects and camera for debugging.
     const std::vector<std::unique_ptr<Object>> &getObjects() const { return objects; }
     const Camera &getCamera() const { return camera; }
 
+    /// Stop following reflections once the product of the mirror weights
+    /// along the ray path drops below \c _min_throughput. 0 follows all
+    /// reflections up to the recursion depth given in the scene file.
+    void setMinThroughput(double _min_throughput) { min_throughput = _min_throughput; }
+
+    /// Replace the camera, e.g., to render the frames of an animation.
+    void setCamera(const Camera &_camera) { camera = _camera; }
+
+    /// Per-thread busy/idle times of the last call to render().
+    const std::vector<TileScheduler::ThreadStatistics> &getRenderStatistics() const { return render_statistics; }
+
 private:
+    /// renders the scene in stages, using the scene's data directly
+    friend class WavefrontRenderer;
+
+    /// a reflective hit along a ray path, see shade()
+    template <class Scalar>
+    struct Bounce
+    {
+        /// local Phong lighting at the hit
+        Vec3T<Scalar> color;
+        /// mirror weight of the hit material
+        Scalar mirror;
+    };
+
+    /// reflective hits of the ray path followed by shade() in this thread
+    template <class Scalar>
+    static std::vector<Bounce<Scalar>>& bounce_stack();
+
+    /// Trace the primary rays of the pixels of \c _tile in precision
+    /// \c Scalar and store their colors in \c _img
+    template <class Scalar>
+    void raytrace_tile(const TileScheduler::Tile& _tile, Image& _img);
+
     /// camera stores eye position, view direction, and can generate primary rays
     Camera camera;
 
@@ -85,9 +220,28 @@ private:
     /// array for all the objects in the scene
     std::vector<std::unique_ptr<Object>> objects;
 
+    /// the spheres, cylinders, and planes of `objects`, intersected without
+    /// virtual calls
+    PrimitiveArrays primitives;
+
+    /// bounding volume hierarchy over the other bounded objects (e.g., meshes)
+    BVH bvh;
+
+    /// indices (into `objects`) of the objects stored in `bvh`
+    std::vector<int> bounded_objects;
+
+    /// indices (into `objects`) of the other unbounded objects, tested linearly
+    std::vector<int> unbounded_objects;
+
+    /// per-thread statistics of the last call to render()
+    std::vector<TileScheduler::ThreadStatistics> render_statistics;
+
     /// max recursion depth for mirroring
     int max_depth = 0;
 
+    /// minimum product of mirror weights for which reflections are traced
+    double min_throughput = 0.0;
+
     /// background color
     vec3 background = vec3(0, 0, 0);
 
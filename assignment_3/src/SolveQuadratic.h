@@ -13,6 +13,8 @@
 #define SOLVEQUADRATIC_H
 #include <cmath>
 #include <array>
+#include <limits>
+#include <algorithm>
 
 /// Numerically robust solution to (possibly degenerate) quadratic equations.
 /// Avoids catastrophic cancellation and handles equations that have
@@ -20,15 +22,16 @@
 /// @param[in]   a,b,c    coefficients of ax^2 + bx + c == 0
 /// @param[out]  solns    array holding between 0 and 2 solutions
 /// @return      number of solutions found
-inline size_t solveQuadratic(double a, double b, double c, std::array<double, 2> &solns) {
+template <class Scalar>
+inline size_t solveQuadratic(Scalar a, Scalar b, Scalar c, std::array<Scalar, 2> &solns) {
     // Handle degenerate (linear) case
-    if (std::abs(a) < 1e-10) {
-        if (std::abs(b) < 1e-10) return 0;
+    if (std::abs(a) < Scalar(1e-10)) {
+        if (std::abs(b) < Scalar(1e-10)) return 0;
         solns[0] = - c / b;
         return 1;
     }
 
-    double discriminant = b * b - 4 * a * c;
+    Scalar discriminant = b * b - 4 * a * c;
     if (discriminant < 0) return 0;
 
     // Avoid cancellation:
@@ -36,10 +39,33 @@ inline size_t solveQuadratic(double a, double b, double c, std::array<double, 2>
     //      a * x1 = 1 / 2 [-b - bSign * sqrt(b^2 - 4ac)]
     // "x2" can be found from the fact:
     //      a * x1 * x2 = c
-    double a_x1 = -0.5 * (b + copysign(std::sqrt(discriminant), b));
+    Scalar a_x1 = Scalar(-0.5) * (b + std::copysign(std::sqrt(discriminant), b));
 
     solns = { a_x1 / a, c / a_x1 };
     return 2;
 }
 
+/// Branch-free variant of solveQuadratic() for use in vectorized loops.
+/// Computes bit-identical solutions, but always stores two values; missing
+/// solutions are set to NaN, so that every comparison with them fails.
+/// @param[in]   a,b,c    coefficients of ax^2 + bx + c == 0
+/// @param[out]  x0, x1   the solutions, or NaN
+template <class Scalar>
+inline void solveQuadraticSelect(Scalar a, Scalar b, Scalar c, Scalar &x0, Scalar &x1) {
+    const Scalar nan = std::numeric_limits<Scalar>::quiet_NaN();
+
+    // quadratic case, see solveQuadratic()
+    const Scalar discriminant = b * b - 4 * a * c;
+    const Scalar a_x1 = Scalar(-0.5) * (b + std::copysign(std::sqrt(std::max(discriminant, Scalar(0))), b));
+    const Scalar q0 = (discriminant < 0) ? nan : a_x1 / a;
+    const Scalar q1 = (discriminant < 0) ? nan : c / a_x1;
+
+    // degenerate (linear) case
+    const Scalar l0 = (std::abs(b) < Scalar(1e-10)) ? nan : - c / b;
+
+    const bool linear = (std::abs(a) < Scalar(1e-10));
+    x0 = linear ? l0  : q0;
+    x1 = linear ? nan : q1;
+}
+
 #endif /* end of include guard: SOLVEQUADRATIC_H */
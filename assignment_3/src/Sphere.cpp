@@ -29,6 +29,29 @@ Sphere::Sphere(const vec3& _center, double _radius)
 bool
 Sphere::
 intersect(const Ray& ray, vec3& intersection_point, vec3& intersection_normal, double& intersection_t) const
+{
+    return intersect_impl(ray, intersection_point, intersection_normal, intersection_t);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Sphere::
+intersect(const Rayf& ray, vec3f& intersection_point, vec3f& intersection_normal, float& intersection_t) const
+{
+    return intersect_impl(ray, intersection_point, intersection_normal, intersection_t);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+bool
+Sphere::
+intersect_impl(const RayT<Scalar>& ray, Vec3T<Scalar>& intersection_point, Vec3T<Scalar>& intersection_normal, Scalar& intersection_t) const
 {
     /*
     We are solving the equation:
@@ -39,23 +62,24 @@ intersect(const Ray& ray, vec3& intersection_point, vec3& intersection_normal, d
         o = ray.origin
         r = radius
     */
-    const vec3 &d = ray.direction;
-    const vec3 oc = ray.origin - center;
-    std::array<double, 2> t;
+    const Vec3T<Scalar> &d = ray.direction;
+    const Vec3T<Scalar> oc = ray.origin - Vec3T<Scalar>(center);
+    const Scalar        r  = Scalar(radius);
+    std::array<Scalar, 2> t;
 
     size_t number_of_solutions = solveQuadratic(
         dot(d, d),                     // t^2 * ||d||^2
         2 * dot(d, oc),                // t * (2d dot (o - c))
-        dot(oc, oc) - radius * radius, // ||o-c||^2 - r^2
+        dot(oc, oc) - r * r,           // ||o-c||^2 - r^2
         t                              // where to store solutions
     );
 
     // Initialize the intersection distance to "infinity" (indicating no intersection)
-    intersection_t = NO_INTERSECTION;
+    intersection_t = std::numeric_limits<Scalar>::infinity();
 
     // Find the closest valid (in front of the viewer) intersection, if one exists
     for (size_t i = 0; i < number_of_solutions; i++) {
-        const double t_solution = t[i];
+        const Scalar t_solution = t[i];
 
         // t <= 0 means the intersection is behind the camera
         if ((t_solution > 0) && (t_solution < intersection_t)) {
@@ -64,13 +88,132 @@ intersect(const Ray& ray, vec3& intersection_point, vec3& intersection_normal, d
     }
 
     // Nothing to do if we don't have an intersection...
-    if (intersection_t == NO_INTERSECTION) return false;
+    if (intersection_t == std::numeric_limits<Scalar>::infinity()) return false;
 
     // Otherwise, calculate information about the intersection
-    intersection_point  = ray(intersection_t);
-    intersection_normal = (intersection_point - center) / radius;
+    surface_impl(ray, intersection_t, intersection_point, intersection_normal);
 
     return true;
 }
 
+
+//-----------------------------------------------------------------------------
+
+
+void
+Sphere::
+surface(const Ray& ray, const Hit& hit, vec3& point, vec3& normal) const
+{
+    surface_impl(ray, hit.t, point, normal);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Sphere::
+surface(const Rayf& ray, const Hitf& hit, vec3f& point, vec3f& normal) const
+{
+    surface_impl(ray, hit.t, point, normal);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+void
+Sphere::
+surface_impl(const RayT<Scalar>& ray, Scalar t, Vec3T<Scalar>& point, Vec3T<Scalar>& normal) const
+{
+    point  = ray(t);
+    normal = (point - Vec3T<Scalar>(center)) / Scalar(radius);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Sphere::
+intersect_packet(const RayPacket& packet, Hit* hits, bool* hit) const
+{
+    // Same computation as in Sphere::intersect(), written as a loop over
+    // the lanes with selects instead of branches.
+    const double cx = center[0], cy = center[1], cz = center[2];
+    const double r2 = radius * radius;
+
+    for (int i = 0; i < packet.size; ++i)
+    {
+        const double dx = packet.dx[i], dy = packet.dy[i], dz = packet.dz[i];
+        const double ocx = packet.ox[i] - cx;
+        const double ocy = packet.oy[i] - cy;
+        const double ocz = packet.oz[i] - cz;
+
+        double t0, t1;
+        solveQuadraticSelect(dx*dx + dy*dy + dz*dz,
+                             2 * (dx*ocx + dy*ocy + dz*ocz),
+                             (ocx*ocx + ocy*ocy + ocz*ocz) - r2,
+                             t0, t1);
+
+        // closest solution in front of the viewer
+        double ti = NO_INTERSECTION;
+        ti = ((t0 > 0) && (t0 < ti)) ? t0 : ti;
+        ti = ((t1 > 0) && (t1 < ti)) ? t1 : ti;
+
+        hit[i]    = (ti != NO_INTERSECTION) && (ti <= hits[i].t);
+        hits[i].t = hit[i] ? ti : hits[i].t;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Sphere::
+occluded(const Ray& ray, double tmax) const
+{
+    return occluded_impl(ray, tmax);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Sphere::
+occluded(const Rayf& ray, float tmax) const
+{
+    return occluded_impl(ray, tmax);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Scalar>
+bool
+Sphere::
+occluded_impl(const RayT<Scalar>& ray, Scalar tmax) const
+{
+    const Vec3T<Scalar> &d = ray.direction;
+    const Vec3T<Scalar> oc = ray.origin - Vec3T<Scalar>(center);
+    const Scalar        r  = Scalar(radius);
+    std::array<Scalar, 2> t;
+
+    size_t number_of_solutions = solveQuadratic(dot(d, d),
+                                                2 * dot(d, oc),
+                                                dot(oc, oc) - r * r,
+                                                t);
+
+    for (size_t i = 0; i < number_of_solutions; i++)
+        if ((t[i] > 0) && (t[i] < tmax))
+            return true;
+
+    return false;
+}
+
+
 //=============================================================================
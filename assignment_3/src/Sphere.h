@@ -45,12 +45,68 @@ public:
                            vec3&       _intersection_normal,
                            double&     _intersection_t) const override;
 
+    /// Single precision version of intersect().
+    /// This function overrides Object::intersect().
+    virtual bool intersect(const Rayf& _ray,
+                           vec3f&      _intersection_point,
+                           vec3f&      _intersection_normal,
+                           float&      _intersection_t) const override;
+
+    /// Compute intersection point and normal of a hit found by intersect().
+    /// This function overrides Object::surface().
+    virtual void surface(const Ray& _ray, const Hit& _hit, vec3& _point, vec3& _normal) const override;
+
+    /// Single precision version of surface().
+    /// This function overrides Object::surface().
+    virtual void surface(const Rayf& _ray, const Hitf& _hit, vec3f& _point, vec3f& _normal) const override;
+
+    /// Intersect the sphere with all rays of \c _packet.
+    /// This function overrides Object::intersect_packet().
+    virtual void intersect_packet(const RayPacket& _packet, Hit* _hits, bool* _hit) const override;
+
+    /// Does \c _ray hit the sphere at any ray parameter in (0, \c _tmax)?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray, double _tmax) const override;
+
+    /// Single precision version of occluded().
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Rayf& _ray, float _tmax) const override;
+
+    /// Compute the bounding box of the sphere.
+    virtual bool bounds(vec3& _bb_min, vec3& _bb_max) const override {
+        _bb_min = center - vec3(radius);
+        _bb_max = center + vec3(radius);
+        return true;
+    }
+
     /// parse sphere from an input stream
     virtual void parse(std::istream &is) override {
         is >> center >> radius >> material;
     }
 
 private:
+    /// intersect() for both scalar types, evaluated in precision \c Scalar
+    template <class Scalar>
+    bool intersect_impl(const RayT<Scalar>& _ray,
+                        Vec3T<Scalar>&      _intersection_point,
+                        Vec3T<Scalar>&      _intersection_normal,
+                        Scalar&             _intersection_t) const;
+
+    /// surface() for both scalar types, intersection point and normal at the
+    /// ray parameter \c _t
+    template <class Scalar>
+    void surface_impl(const RayT<Scalar>& _ray, Scalar _t,
+                      Vec3T<Scalar>& _point, Vec3T<Scalar>& _normal) const;
+
+    /// occluded() for both scalar types, evaluated in precision \c Scalar
+    template <class Scalar>
+    bool occluded_impl(const RayT<Scalar>& _ray, Scalar _tmax) const;
+
+private:
+    /// stores the parameters of all scene spheres, cylinders, and planes as
+    /// structure of arrays, see Scene::intersect()
+    friend class PrimitiveArrays;
+
     /// center position of the sphere
     vec3   center;
 
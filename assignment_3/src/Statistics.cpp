@@ -0,0 +1,336 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+#include "Statistics.h"
+#include "Image.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+bool Statistics::enabled    = false;
+bool Statistics::recording_ = false;
+
+
+namespace {
+
+/// the counters of all threads that have exited, guarded by totals_mutex
+Statistics::Totals totals_;
+std::mutex         totals_mutex;
+
+/// per-pixel counters of the recorded image, one array per counter; each
+/// pixel is only written by the thread that traces it
+std::vector<unsigned long long> pixels_[Statistics::NUM_COUNTERS];
+unsigned int pixels_width_  = 0;
+unsigned int pixels_height_ = 0;
+
+/// the innermost running phase timer of the calling thread
+thread_local Statistics::PhaseTimer* current_phase = nullptr;
+
+
+/// clear counters, hits, and times of \c _totals
+void clear(Statistics::Totals& _totals)
+{
+    std::fill(_totals.counters, _totals.counters + Statistics::NUM_COUNTERS, 0ull);
+    std::fill(_totals.phase_ms, _totals.phase_ms + Statistics::NUM_PHASES, 0.0);
+    _totals.object_hits.clear();
+}
+
+
+/// add \c _from to \c _to
+void merge(Statistics::Totals& _to, const Statistics::Totals& _from)
+{
+    for (int i = 0; i < Statistics::NUM_COUNTERS; ++i)
+        _to.counters[i] += _from.counters[i];
+    for (int i = 0; i < Statistics::NUM_PHASES; ++i)
+        _to.phase_ms[i] += _from.phase_ms[i];
+    if (_to.object_hits.size() < _from.object_hits.size())
+        _to.object_hits.resize(_from.object_hits.size(), 0);
+    for (size_t i = 0; i < _from.object_hits.size(); ++i)
+        _to.object_hits[i] += _from.object_hits[i];
+}
+
+
+/// The counters of one thread, added to totals_ when the thread exits.
+struct ThreadCounters
+{
+    ThreadCounters()
+    {
+        clear(counters);
+        std::fill(snapshot, snapshot + Statistics::NUM_COUNTERS, 0ull);
+    }
+
+    ~ThreadCounters()
+    {
+        flush();
+    }
+
+    /// add the counters to totals_ and clear them
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(totals_mutex);
+        merge(totals_, counters);
+        clear(counters);
+    }
+
+    /// the counters since the last flush
+    Statistics::Totals counters;
+    /// the counters at the last begin_pixels()
+    unsigned long long snapshot[Statistics::NUM_COUNTERS];
+};
+
+thread_local ThreadCounters thread_counters;
+
+} // namespace
+
+
+//-----------------------------------------------------------------------------
+
+
+void Statistics::add(Counter _counter, unsigned long long _n)
+{
+    thread_counters.counters.counters[_counter] += _n;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Statistics::add_hit(int _object)
+{
+    if (_object < 0) return;
+    std::vector<unsigned long long>& hits = thread_counters.counters.object_hits;
+    if (hits.size() <= size_t(_object)) hits.resize(_object + 1, 0);
+    ++hits[_object];
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Statistics::record_pixels(unsigned int _width, unsigned int _height)
+{
+    pixels_width_  = _width;
+    pixels_height_ = _height;
+    for (auto& p: pixels_)
+        p.assign(size_t(_width) * _height, 0);
+    recording_ = true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Statistics::stop_recording_pixels()
+{
+    recording_ = false;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Statistics::begin_pixels_impl()
+{
+    ThreadCounters& tc = thread_counters;
+    std::copy(tc.counters.counters, tc.counters.counters + NUM_COUNTERS, tc.snapshot);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Statistics::end_pixels_impl(unsigned int _x0, unsigned int _y0, unsigned int _x1, unsigned int _y1)
+{
+    _x1 = std::min(_x1, pixels_width_);
+    _y1 = std::min(_y1, pixels_height_);
+    if (_x0 >= _x1 || _y0 >= _y1) return;
+
+    const unsigned long long n = (unsigned long long)(_x1 - _x0) * (_y1 - _y0);
+    ThreadCounters& tc = thread_counters;
+
+    for (int c = 0; c < NUM_COUNTERS; ++c)
+    {
+        const unsigned long long events = tc.counters.counters[c] - tc.snapshot[c];
+        if (events == 0) continue;
+
+        // distribute the remainder over the first pixels
+        const unsigned long long share = events / n;
+        unsigned long long remainder   = events % n;
+        for (unsigned int y = _y0; y < _y1; ++y)
+            for (unsigned int x = _x0; x < _x1; ++x)
+            {
+                pixels_[c][size_t(y) * pixels_width_ + x] += share + (remainder ? 1 : 0);
+                if (remainder) --remainder;
+            }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Statistics::reset()
+{
+    thread_counters.flush();
+    {
+        std::lock_guard<std::mutex> lock(totals_mutex);
+        clear(totals_);
+    }
+    for (auto& p: pixels_)
+        std::fill(p.begin(), p.end(), 0ull);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Statistics::Totals Statistics::totals()
+{
+    thread_counters.flush();
+    std::lock_guard<std::mutex> lock(totals_mutex);
+    return totals_;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+const char* Statistics::name(Counter _counter)
+{
+    switch (_counter)
+    {
+        case PRIMARY_RAYS:    return "primary_rays";
+        case SHADOW_RAYS:     return "shadow_rays";
+        case REFLECTION_RAYS: return "reflection_rays";
+        case BOX_TESTS:       return "box_tests";
+        case TRIANGLE_TESTS:  return "triangle_tests";
+        case OBJECT_TESTS:    return "object_tests";
+        default:              return "unknown";
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+const char* Statistics::name(Phase _phase)
+{
+    switch (_phase)
+    {
+        case PARSE:  return "parse";
+        case BUILD:  return "build";
+        case RENDER: return "render";
+        case ENCODE: return "encode";
+        default:     return "unknown";
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Statistics::write_json(std::ostream& _os, const std::string& _scene,
+                            unsigned int _width, unsigned int _height, const Totals& _totals)
+{
+    // escape the scene name as a JSON string
+    std::string scene;
+    for (char ch: _scene)
+    {
+        if (ch == '"' || ch == '\\') scene += '\\';
+        scene += ch;
+    }
+
+    _os << "{\n  \"scene\": \"" << scene << "\",\n"
+        << "  \"width\": " << _width << ",\n  \"height\": " << _height << ",\n"
+        << "  \"counters\": {";
+    for (int c = 0; c < NUM_COUNTERS; ++c)
+        _os << (c ? ", " : " ") << '"' << name(Counter(c)) << "\": " << _totals.counters[c];
+
+    _os << " },\n  \"phases_ms\": {" << std::fixed << std::setprecision(3);
+    for (int p = 0; p < NUM_PHASES; ++p)
+        _os << (p ? ", " : " ") << '"' << name(Phase(p)) << "\": " << _totals.phase_ms[p];
+    _os.unsetf(std::ios_base::floatfield);
+
+    _os << " },\n  \"object_hits\": [";
+    for (size_t i = 0; i < _totals.object_hits.size(); ++i)
+        _os << (i ? ", " : "") << _totals.object_hits[i];
+    _os << "]\n}";
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Statistics::write_heatmaps(const std::string& _prefix)
+{
+    if (pixels_width_ == 0 || pixels_height_ == 0) return false;
+
+    bool ok = true;
+    for (int c = 0; c < NUM_COUNTERS; ++c)
+    {
+        const std::vector<unsigned long long>& counts = pixels_[c];
+        const unsigned long long max_count = *std::max_element(counts.begin(), counts.end());
+
+        Image img(pixels_width_, pixels_height_);
+        for (unsigned int y = 0; y < pixels_height_; ++y)
+            for (unsigned int x = 0; x < pixels_width_; ++x)
+            {
+                const unsigned long long n = counts[size_t(y) * pixels_width_ + x];
+                img.set(x, y, vec3(max_count ? double(n) / double(max_count) : 0.0, 0, 0));
+            }
+
+        ok = img.write(_prefix + "_" + name(Counter(c)) + ".png") && ok;
+    }
+    return ok;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Statistics::PhaseTimer::PhaseTimer(Phase _phase)
+    : phase_(_phase), outer_(nullptr), active_(Statistics::enabled), scope_(name(_phase))
+{
+    if (!active_) return;
+
+    // pause the enclosing phase
+    outer_ = current_phase;
+    if (outer_)
+        thread_counters.counters.phase_ms[outer_->phase_] += outer_->watch_.stop();
+    current_phase = this;
+
+    watch_.start();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Statistics::PhaseTimer::~PhaseTimer()
+{
+    if (!active_) return;
+
+    thread_counters.counters.phase_ms[phase_] += watch_.stop();
+
+    // resume the enclosing phase
+    current_phase = outer_;
+    if (outer_) outer_->watch_.start();
+}
+
+
+//=============================================================================
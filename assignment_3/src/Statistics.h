@@ -0,0 +1,205 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+
+//== INCLUDES =================================================================
+
+#include "StopWatch.h"
+#include "Profiler.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class Statistics Statistics.h
+/// This class counts the work done by the ray tracer: rays, ray-box tests,
+/// ray-triangle tests, and ray-object tests, the closest hits per object,
+/// and the wall time of the phases of a run. Every thread counts into its
+/// own accumulators, which are added to the totals when the thread exits,
+/// so counting needs no synchronization. Counting is disabled by default;
+/// then every call only checks a flag. The traversal loops count into local
+/// variables and report once per ray.
+///
+/// While an image is traced, the counters can also be recorded per pixel
+/// (see begin_pixels()) and written as heatmaps.
+class Statistics
+{
+public:
+
+    /// the counted events
+    enum Counter
+    {
+        /// primary rays
+        PRIMARY_RAYS,
+        /// shadow rays, see Scene::occluded()
+        SHADOW_RAYS,
+        /// reflected rays
+        REFLECTION_RAYS,
+        /// ray-box tests of BVH nodes
+        BOX_TESTS,
+        /// ray-triangle tests of meshes
+        TRIANGLE_TESTS,
+        /// ray-object tests of spheres, cylinders, planes, and other
+        /// objects (meshes count once per test of the whole mesh)
+        OBJECT_TESTS,
+        NUM_COUNTERS
+    };
+
+    /// the timed phases of a run
+    enum Phase
+    {
+        /// reading the scene and its meshes
+        PARSE,
+        /// building the acceleration structures
+        BUILD,
+        /// ray tracing the image
+        RENDER,
+        /// writing the image
+        ENCODE,
+        NUM_PHASES
+    };
+
+    /// the counters and times of all threads, see totals()
+    struct Totals
+    {
+        /// number of events per Counter
+        unsigned long long counters[NUM_COUNTERS];
+        /// number of closest hits per object (index of Scene::objects)
+        std::vector<unsigned long long> object_hits;
+        /// wall time per Phase in ms
+        double phase_ms[NUM_PHASES];
+    };
+
+    /// Time a phase for the lifetime of the timer. Phases may be nested
+    /// (e.g., building a BVH while parsing a mesh), the time of the inner
+    /// phase is not counted for the outer one. Only the main thread
+    /// should time phases. The phase is also timed as a Profiler::Scope.
+    class PhaseTimer
+    {
+    public:
+        /// Start timing \c _phase (if statistics are enabled) and pause the
+        /// enclosing phase
+        PhaseTimer(Phase _phase);
+
+        /// Add the time to the phase and resume the enclosing phase
+        ~PhaseTimer();
+
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    private:
+        /// the timed phase
+        Phase phase_;
+        /// the enclosing phase, or nullptr
+        PhaseTimer* outer_;
+        /// measures the time since the start or the last resume
+        StopWatch watch_;
+        /// is the timer running, i.e., were statistics enabled at construction?
+        bool active_;
+        /// the phase as scope of the Profiler
+        Profiler::Scope scope_;
+    };
+
+public:
+
+    /// Collect statistics? Disabled by default.
+    static bool enabled;
+
+    /// Count \c _n events of type \c _counter in the calling thread
+    static void count(Counter _counter, unsigned long long _n = 1)
+    {
+        if (enabled) add(_counter, _n);
+    }
+
+    /// Count a closest hit of object \c _object (index of Scene::objects)
+    static void count_hit(int _object)
+    {
+        if (enabled) add_hit(_object);
+    }
+
+    /// Start recording the counters per pixel for an image of \c _width
+    /// times \c _height pixels, see begin_pixels() and write_heatmaps().
+    /// Clears the previous per-pixel counters.
+    static void record_pixels(unsigned int _width, unsigned int _height);
+
+    /// Stop recording the counters per pixel.
+    static void stop_recording_pixels();
+
+    /// Mark the start of the work for a block of pixels in the calling
+    /// thread, see end_pixels().
+    static void begin_pixels()
+    {
+        if (enabled && recording_) begin_pixels_impl();
+    }
+
+    /// Assign the events counted by the calling thread since begin_pixels()
+    /// to the pixels [\c _x0, \c _x1) x [\c _y0, \c _y1), evenly distributed
+    /// if there is more than one (e.g., for a packet of rays).
+    static void end_pixels(unsigned int _x0, unsigned int _y0, unsigned int _x1, unsigned int _y1)
+    {
+        if (enabled && recording_) end_pixels_impl(_x0, _y0, _x1, _y1);
+    }
+
+    /// Clear all counters, times, and per-pixel counters. Must not be
+    /// called while other threads are counting.
+    static void reset();
+
+    /// Counters and times of all threads that have exited and of the
+    /// calling thread.
+    static Totals totals();
+
+    /// Write \c _totals for the scene \c _scene, rendered at \c _width
+    /// times \c _height pixels, as a JSON object to \c _os.
+    static void write_json(std::ostream& _os, const std::string& _scene,
+                           unsigned int _width, unsigned int _height, const Totals& _totals);
+
+    /// Write one heatmap per counter of the recorded pixels, named
+    /// \c _prefix + "_" + counter name + ".png". The red channel is the
+    /// count relative to the largest count of the image, like debug_aabb.
+    /// Returns false if nothing was recorded or an image cannot be written.
+    static bool write_heatmaps(const std::string& _prefix);
+
+    /// Name of \c _counter in the JSON output and in heatmap file names
+    static const char* name(Counter _counter);
+
+    /// Name of \c _phase in the JSON output
+    static const char* name(Phase _phase);
+
+private:
+
+    /// add \c _n to \c _counter of the calling thread
+    static void add(Counter _counter, unsigned long long _n);
+
+    /// add a hit of \c _object in the calling thread
+    static void add_hit(int _object);
+
+    /// see begin_pixels()
+    static void begin_pixels_impl();
+
+    /// see end_pixels()
+    static void end_pixels_impl(unsigned int _x0, unsigned int _y0, unsigned int _x1, unsigned int _y1);
+
+private:
+
+    /// are counters recorded per pixel?
+    static bool recording_;
+};
+
+
+//=============================================================================
+#endif // STATISTICS_H defined
+//=============================================================================
@@ -14,12 +14,7 @@
 
 //== INCLUDES =================================================================
 
-#ifdef _WIN32
-#  include <windows.h>
-#else // Unix
-#  include <sys/time.h>
-#endif
-
+#include <chrono>
 #include <iostream>
 
 
@@ -28,75 +23,67 @@
 
 /// \class StopWatch StopWatch.h
 /// This class implements a simple stop watch, that you can start() and stop()
-/// and that returns the elapsed() time in milliseconds.
+/// and that returns the elapsed() time in milliseconds. It uses the steady
+/// clock of the C++ library, which is monotonic (unaffected by changes of
+/// the system time) and has a resolution of nanoseconds on common platforms.
+/// A stopped watch can be resume()d to measure the total time of several
+/// intervals. For timing nested parts of the program, see Profiler.
 class StopWatch
 {
 public:
-    
+
+    /// the clock used for all measurements
+    typedef std::chrono::steady_clock Clock;
+
     /// Constructor
-    StopWatch()
+    StopWatch() : elapsed_(0.0), running_(false) {}
+
+
+    /// Start time measurement, discarding previous intervals
+    void start()
     {
-#ifdef _WIN32 // Windows
-        QueryPerformanceFrequency(&freq_);
-#endif
+        elapsed_ = 0.0;
+        resume();
     }
-    
-    
-    /// Start time measurement
-    void start()
+
+
+    /// Continue time measurement, adding to the previous intervals
+    void resume()
     {
-#ifdef _WIN32 // Windows
-        QueryPerformanceCounter(&starttime_);
-#else // Linux
-        starttime_ = current_time();
-#endif
+        starttime_ = Clock::now();
+        running_   = true;
     }
-    
-    
+
+
     /// Stop time measurement, return elapsed time in ms
     double stop()
     {
-#ifdef _WIN32 // Windows
-        QueryPerformanceCounter(&endtime_);
-#else // Unix
-        endtime_ = current_time();
-#endif
-        return elapsed();
+        if (running_)
+        {
+            elapsed_ += std::chrono::duration<double, std::milli>(Clock::now() - starttime_).count();
+            running_  = false;
+        }
+        return elapsed_;
     }
-    
-    
+
+
     /// Return elapsed time in ms (watch has to be stopped).
     double elapsed() const
     {
-#ifdef _WIN32 // Windows
-        return ((double)(endtime_.QuadPart - starttime_.QuadPart)
-                / (double)freq_.QuadPart * 1000.0f);
-#else // Unix
-        return ((endtime_.tv_sec  - starttime_.tv_sec )*1000.0 +
-                (endtime_.tv_usec - starttime_.tv_usec)*0.001);
-#endif
+        return elapsed_;
     }
-    
-    
+
+
 private:
-    
-#ifdef _WIN32 // Windows
-    
-    LARGE_INTEGER starttime_, endtime_;
-    LARGE_INTEGER freq_;
-    
-#else // Unix
-    
-    timeval current_time() const
-    {
-        struct timeval tv;
-        gettimeofday(&tv, 0);
-        return tv;
-    }
-    
-    timeval starttime_, endtime_;
-    
-#endif
+
+    /// start of the current interval
+    Clock::time_point starttime_;
+
+    /// total time of the stopped intervals in ms
+    double elapsed_;
+
+    /// is an interval being measured?
+    bool running_;
 };
 
 
@@ -0,0 +1,253 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "TileScheduler.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsed_ms(const Clock::time_point& _start, const Clock::time_point& _end)
+{
+    return std::chrono::duration<double, std::milli>(_end - _start).count();
+}
+
+/// interleave the bits of x and y to get the index on the Morton (Z-order) curve
+unsigned long long morton_index(unsigned int _x, unsigned int _y)
+{
+    unsigned long long d = 0;
+    for (unsigned int b = 0; b < 32; ++b)
+    {
+        d |= (unsigned long long)((_x >> b) & 1) << (2 * b);
+        d |= (unsigned long long)((_y >> b) & 1) << (2 * b + 1);
+    }
+    return d;
+}
+
+/// index of (x,y) on the Hilbert curve filling an n x n grid, n a power of two
+unsigned long long hilbert_index(unsigned int _n, unsigned int _x, unsigned int _y)
+{
+    unsigned long long d = 0;
+    for (unsigned int s = _n / 2; s > 0; s /= 2)
+    {
+        const unsigned int rx = (_x & s) > 0;
+        const unsigned int ry = (_y & s) > 0;
+        d += (unsigned long long)s * s * ((3 * rx) ^ ry);
+
+        // rotate the quadrant
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                _x = _n - 1 - _x;
+                _y = _n - 1 - _y;
+            }
+            std::swap(_x, _y);
+        }
+    }
+    return d;
+}
+
+/// a queue of tile indices, owned by one thread but open to thieves
+struct TileQueue
+{
+    std::mutex      mutex;
+    std::deque<int> tiles;
+
+    /// take the next tile of the owning thread
+    bool pop_front(int& _tile)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tiles.empty()) return false;
+        _tile = tiles.front();
+        tiles.pop_front();
+        return true;
+    }
+
+    /// steal the tile the owning thread would process last
+    bool pop_back(int& _tile)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tiles.empty()) return false;
+        _tile = tiles.back();
+        tiles.pop_back();
+        return true;
+    }
+};
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+
+TileScheduler::TileScheduler(unsigned int _width, unsigned int _height,
+                             const Settings& _settings)
+{
+    const unsigned int size = std::max(1u, _settings.tile_size);
+    const unsigned int nx   = (_width  + size - 1) / size;
+    const unsigned int ny   = (_height + size - 1) / size;
+
+    tiles_.reserve(nx * ny);
+    for (unsigned int ty = 0; ty < ny; ++ty)
+    {
+        for (unsigned int tx = 0; tx < nx; ++tx)
+        {
+            Tile tile;
+            tile.x0 = tx * size;
+            tile.y0 = ty * size;
+            tile.x1 = std::min(_width,  tile.x0 + size);
+            tile.y1 = std::min(_height, tile.y0 + size);
+            tiles_.push_back(tile);
+        }
+    }
+    sort_tiles(nx, ny, _settings.order);
+
+    num_threads_ = _settings.num_threads;
+    if (num_threads_ == 0)
+        num_threads_ = std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void TileScheduler::sort_tiles(unsigned int _nx, unsigned int _ny, Order _order)
+{
+    if (_order == SCANLINE) return;
+
+    unsigned int n = 1;
+    while (n < std::max(_nx, _ny)) n *= 2;
+
+    std::vector<std::pair<unsigned long long, int> > keys(tiles_.size());
+    for (size_t i = 0; i < tiles_.size(); ++i)
+    {
+        const unsigned int tx = i % _nx, ty = i / _nx;
+        keys[i].first  = (_order == MORTON) ? morton_index(tx, ty) : hilbert_index(n, tx, ty);
+        keys[i].second = int(i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<Tile> sorted(tiles_.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        sorted[i] = tiles_[keys[i].second];
+    tiles_.swap(sorted);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void TileScheduler::run(const std::function<void(const Tile&)>& _process_tile)
+{
+    const int num_threads = int(std::min<size_t>(num_threads_, std::max<size_t>(1, tiles_.size())));
+    statistics_.assign(num_threads, ThreadStatistics());
+
+    // give each thread a contiguous chunk of the space filling curve
+    std::vector<std::unique_ptr<TileQueue> > queues;
+    for (int k = 0; k < num_threads; ++k)
+    {
+        queues.emplace_back(new TileQueue);
+        const size_t begin = tiles_.size() *  k      / num_threads;
+        const size_t end   = tiles_.size() * (k + 1) / num_threads;
+        for (size_t i = begin; i < end; ++i)
+            queues[k]->tiles.push_back(int(i));
+    }
+
+    const Clock::time_point start = Clock::now();
+
+    auto worker = [&](int k)
+    {
+        ThreadStatistics& stats = statistics_[k];
+        int tile;
+
+        for (;;)
+        {
+            if (!queues[k]->pop_front(tile))
+            {
+                // Own queue is empty: try to steal from the other threads.
+                // No tiles are created during the run, so we are done once
+                // all queues are empty.
+                bool stolen = false;
+                for (int j = 1; j < num_threads && !stolen; ++j)
+                    stolen = queues[(k + j) % num_threads]->pop_back(tile);
+                if (!stolen) break;
+                ++stats.steals;
+            }
+
+            const Clock::time_point tile_start = Clock::now();
+            Profiler::Scope scope("tile");
+            _process_tile(tiles_[tile]);
+            stats.busy_ms += elapsed_ms(tile_start, Clock::now());
+            ++stats.tiles;
+        }
+    };
+
+    // the calling thread acts as worker 0, the other workers continue its
+    // profiler scope
+    const std::vector<std::string> path = Profiler::current_path();
+    std::vector<std::thread> threads;
+    for (int k = 1; k < num_threads; ++k)
+        threads.emplace_back([&](int _k) { Profiler::Attach attach(path); worker(_k); }, k);
+    worker(0);
+    for (std::thread& t: threads)
+        t.join();
+
+    const double total_ms = elapsed_ms(start, Clock::now());
+    for (ThreadStatistics& stats: statistics_)
+        stats.idle_ms = std::max(0.0, total_ms - stats.busy_ms);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+TileScheduler::Order TileScheduler::parse_order(const std::string& _name)
+{
+    if (_name == "scanline") return SCANLINE;
+    if (_name == "morton")   return MORTON;
+    if (_name == "hilbert")  return HILBERT;
+    throw std::runtime_error("Invalid tile order " + _name);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+std::ostream& operator<<(std::ostream& _os,
+                         const std::vector<TileScheduler::ThreadStatistics>& _stats)
+{
+    for (size_t k = 0; k < _stats.size(); ++k)
+    {
+        const TileScheduler::ThreadStatistics& s = _stats[k];
+        _os << "  thread " << k << ": "
+            << s.tiles << " tiles (" << s.steals << " stolen), "
+            << "busy " << s.busy_ms << " ms, idle " << s.idle_ms << " ms\n";
+    }
+    return _os;
+}
+
+
+//=============================================================================
@@ -0,0 +1,123 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+
+//== INCLUDES =================================================================
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class TileScheduler TileScheduler.h
+/// This class splits an image into rectangular tiles and distributes them
+/// over a set of worker threads. The tiles are enumerated along a space
+/// filling curve and handed out to the threads in contiguous chunks, such
+/// that neighboring tiles are processed by the same thread. A thread that
+/// runs out of tiles steals tiles from the end of another thread's queue.
+/// The scheduler only uses the C++ standard library, so it behaves the same
+/// with or without TBB and OpenMP.
+class TileScheduler
+{
+public:
+
+    /// order in which the tiles are traversed
+    enum Order {SCANLINE, MORTON, HILBERT};
+
+    /// user-configurable scheduling parameters
+    struct Settings
+    {
+        /// default: 16x16 tiles in Hilbert order, one thread per core
+        Settings() : tile_size(16), order(HILBERT), num_threads(0) {}
+
+        /// edge length of the (square) tiles in pixels
+        unsigned int tile_size;
+        /// traversal order of the tiles
+        Order order;
+        /// number of worker threads, 0 means one per hardware thread
+        unsigned int num_threads;
+    };
+
+    /// a rectangular block of pixels [x0, x1) x [y0, y1)
+    struct Tile
+    {
+        unsigned int x0, y0, x1, y1;
+    };
+
+    /// timing information collected for each worker thread
+    struct ThreadStatistics
+    {
+        /// time spent processing tiles in ms
+        double busy_ms = 0.0;
+        /// time spent scheduling or waiting for the other threads in ms
+        double idle_ms = 0.0;
+        /// number of processed tiles
+        unsigned int tiles = 0;
+        /// number of tiles stolen from other threads
+        unsigned int steals = 0;
+    };
+
+    /// Construct a scheduler for an image of size \c _width times \c _height.
+    TileScheduler(unsigned int _width, unsigned int _height,
+                  const Settings& _settings = Settings());
+
+    /// Call \c _process_tile for every tile of the image. Returns after all
+    /// tiles have been processed. \c _process_tile is called concurrently
+    /// from several threads, but never twice for the same tile.
+    void run(const std::function<void(const Tile&)>& _process_tile);
+
+    /// All tiles of the image, in traversal order
+    const std::vector<Tile>& tiles() const { return tiles_; }
+
+    /// Number of worker threads used by run()
+    unsigned int num_threads() const { return num_threads_; }
+
+    /// Statistics of the last call to run(), one entry per thread.
+    const std::vector<ThreadStatistics>& statistics() const { return statistics_; }
+
+    /// Parse a tile order from its name ("scanline", "morton", "hilbert").
+    static Order parse_order(const std::string& _name);
+
+private:
+
+    /// sort tiles_ along the space filling curve given by \c _order
+    void sort_tiles(unsigned int _nx, unsigned int _ny, Order _order);
+
+private:
+
+    /// all tiles of the image, in traversal order
+    std::vector<Tile> tiles_;
+
+    /// number of worker threads
+    unsigned int num_threads_;
+
+    /// per-thread statistics of the last run
+    std::vector<ThreadStatistics> statistics_;
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+/// output the per-thread statistics of a scheduler run
+std::ostream& operator<<(std::ostream& _os,
+                         const std::vector<TileScheduler::ThreadStatistics>& _stats);
+
+
+//=============================================================================
+#endif // TILESCHEDULER_H defined
+//=============================================================================
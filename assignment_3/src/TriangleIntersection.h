@@ -0,0 +1,127 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef TRIANGLEINTERSECTION_H
+#define TRIANGLEINTERSECTION_H
+
+
+//== INCLUDES =================================================================
+
+#include "Ray.h"
+
+#include <cmath>
+#include <utility>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class WatertightRay TriangleIntersection.h
+/// The per-ray constants of the watertight ray-triangle test of Woop,
+/// Benthin, and Wald ("Watertight Ray/Triangle Intersection", JCGT 2013).
+/// The coordinate axes are permuted such that the ray direction is largest
+/// in z, and the triangle vertices, relative to the ray origin, are sheared
+/// such that the ray becomes the positive z axis. The test then reduces to
+/// the signs of three 2D edge functions. Since an edge shared by two
+/// triangles yields the same edge function (up to its sign) in both, a ray
+/// never passes between two adjacent triangles.
+///
+/// The permutation and the shear only depend on the ray and are computed
+/// once per ray by the constructor, see intersect_triangle_watertight().
+template <class Scalar>
+struct WatertightRay
+{
+    /// Uninitialized constructor, e.g. for arrays
+    WatertightRay() {}
+
+    /// Precompute the permutation and the shear for \c _ray
+    explicit WatertightRay(const RayT<Scalar>& _ray)
+    {
+        const Scalar ax = std::abs(_ray.direction[0]);
+        const Scalar ay = std::abs(_ray.direction[1]);
+        const Scalar az = std::abs(_ray.direction[2]);
+        kz = (ax > ay) ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+
+        // keep the winding of the triangles
+        if (_ray.direction[kz] < 0) std::swap(kx, ky);
+
+        sx = _ray.direction[kx] / _ray.direction[kz];
+        sy = _ray.direction[ky] / _ray.direction[kz];
+        sz = Scalar(1) / _ray.direction[kz];
+
+        ox = _ray.origin[kx];
+        oy = _ray.origin[ky];
+        oz = _ray.origin[kz];
+    }
+
+    /// the axes that become x, y, and z
+    int kx, ky, kz;
+    /// the shear constants
+    Scalar sx, sy, sz;
+    /// the permuted ray origin
+    Scalar ox, oy, oz;
+};
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+/// Intersect the ray given by \c _r with the triangle (\c a, \c b, \c c),
+/// whose coordinates are passed in the permuted order of \c _r, i.e.,
+/// \c ax is a[_r.kx], \c ay is a[_r.ky], and \c az is a[_r.kz]. Store the
+/// ray parameter and the barycentric coordinates of \c a and \c b in \c _t,
+/// \c _alpha, and \c _beta. Return whether the ray hits the triangle (from
+/// either side) with t >= 0; hits on an edge or vertex count. Written
+/// without branches, such that loops over several triangles are vectorized.
+template <class Scalar>
+inline bool intersect_triangle_watertight(const WatertightRay<Scalar>& _r,
+                                          Scalar ax, Scalar ay, Scalar az,
+                                          Scalar bx, Scalar by, Scalar bz,
+                                          Scalar cx, Scalar cy, Scalar cz,
+                                          Scalar& _t, Scalar& _alpha, Scalar& _beta)
+{
+    // vertices relative to the ray origin
+    ax -= _r.ox;  ay -= _r.oy;  az -= _r.oz;
+    bx -= _r.ox;  by -= _r.oy;  bz -= _r.oz;
+    cx -= _r.ox;  cy -= _r.oy;  cz -= _r.oz;
+
+    // shear the ray onto the z axis
+    const Scalar sax = ax - _r.sx * az, say = ay - _r.sy * az;
+    const Scalar sbx = bx - _r.sx * bz, sby = by - _r.sy * bz;
+    const Scalar scx = cx - _r.sx * cz, scy = cy - _r.sy * cz;
+
+    // edge functions, i.e., the unnormalized barycentric coordinates
+    const Scalar u = scx * sby - scy * sbx;
+    const Scalar v = sax * scy - say * scx;
+    const Scalar w = sbx * say - sby * sax;
+    const Scalar det = u + v + w;
+
+    // ray parameter, scaled by det
+    const Scalar tt = u * (_r.sz * az) + v * (_r.sz * bz) + w * (_r.sz * cz);
+
+    const Scalar inv = Scalar(1) / det;
+    _t     = tt * inv;
+    _alpha = u * inv;
+    _beta  = v * inv;
+
+    // inside if the edge functions do not have different signs; the
+    // conditions are combined without short-circuit evaluation to avoid
+    // branches
+    const bool negative = (u < 0) | (v < 0) | (w < 0);
+    const bool positive = (u > 0) | (v > 0) | (w > 0);
+    return !(negative & positive) & (det != 0) & (_t >= 0);
+}
+
+
+//=============================================================================
+#endif // TRIANGLEINTERSECTION_H defined
+//=============================================================================
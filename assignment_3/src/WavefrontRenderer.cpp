@@ -0,0 +1,346 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "WavefrontRenderer.h"
+#include "Statistics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+/// number of pixels whose paths are traced together, bounds the memory of
+/// the ray and hit buffers
+static const size_t batch_size = 1 << 14;
+
+
+//-----------------------------------------------------------------------------
+
+
+WavefrontRenderer::WavefrontRenderer(Scene& _scene, const TileScheduler::Settings& _settings)
+: scene_(_scene), settings_(_settings)
+{
+    num_threads_ = _settings.num_threads;
+    if (num_threads_ == 0)
+        num_threads_ = std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Image WavefrontRenderer::render()
+{
+    const Camera& camera = scene_.camera;
+    Image img(camera.width, camera.height);
+
+    // enumerate the pixels tile by tile, such that the rays of a batch (and
+    // of a packet) are coherent
+    TileScheduler scheduler(camera.width, camera.height, settings_);
+    pixels_.clear();
+    pixels_.reserve(size_t(camera.width) * camera.height);
+    for (const TileScheduler::Tile& tile: scheduler.tiles())
+        for (unsigned int y=tile.y0; y<tile.y1; ++y)
+            for (unsigned int x=tile.x0; x<tile.x1; ++x)
+                pixels_.emplace_back(x, y);
+
+    statistics_.clear();
+    for (size_t begin = 0; begin < pixels_.size(); begin += batch_size)
+        render_batch(begin, std::min(pixels_.size(), begin + batch_size), img);
+
+    return img;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void WavefrontRenderer::render_batch(size_t _begin, size_t _end, Image& _img)
+{
+    const Camera& camera = scene_.camera;
+    const int     n = int(_end - _begin);
+
+    // wave 0: primary rays
+    rays_.clear();
+    for (int i = 0; i < n; ++i)
+    {
+        const std::pair<unsigned int, unsigned int>& p = pixels_[_begin + i];
+        rays_.push_back(PathRay{camera.primary_ray(p.first, p.second), i, 1.0});
+    }
+    colors_.assign(n, vec3(0,0,0));
+    Statistics::count(Statistics::PRIMARY_RAYS, n);
+
+    // primary rays are at depth 0; beyond the recursion depth they are
+    // black, see Scene::trace()
+    if (scene_.max_depth < 0) rays_.clear();
+
+    // trace the waves, every wave sets the colors of the paths that end in
+    // it and records the reflective hits of the paths that go on
+    std::vector<std::vector<Bounce>> bounces;
+    for (int depth = 0; !rays_.empty(); ++depth)
+    {
+        if (int(statistics_.size()) <= depth) statistics_.emplace_back();
+        statistics_[depth].rays += rays_.size();
+        if (depth > 0) Statistics::count(Statistics::REFLECTION_RAYS, rays_.size());
+
+        intersect_rays();
+        sort_hits();
+        statistics_[depth].hits += hits_.size();
+
+        bounces.emplace_back();
+        shade_hits(depth, bounces.back());
+    }
+
+    // blend the reflections, starting with the last wave, see Scene::shade()
+    for (auto wave = bounces.rbegin(); wave != bounces.rend(); ++wave)
+    {
+        const std::vector<Bounce>& w = *wave;
+        parallel_for(w.size(), 1024, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; ++i)
+            {
+                vec3& color = colors_[w[i].pixel];
+                color = (1 - w[i].mirror) * w[i].color + w[i].mirror * color;
+            }
+        });
+    }
+
+    // store the pixel colors
+    for (int i = 0; i < n; ++i)
+    {
+        const std::pair<unsigned int, unsigned int>& p = pixels_[_begin + i];
+        _img.set(p.first, p.second, colors_[i]);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void WavefrontRenderer::intersect_rays()
+{
+    const size_t n = rays_.size();
+    const size_t num_packets = (n + RayPacket::MAX_SIZE - 1) / RayPacket::MAX_SIZE;
+    hits_.resize(n);
+
+    // find the closest intersections for packets of consecutive rays, then
+    // compute their points and normals, like Scene::trace_packet()
+    parallel_for(num_packets, 16, [&](size_t b, size_t e)
+    {
+        RayPacket packet;
+        Hit       hit[RayPacket::MAX_SIZE];
+
+        for (size_t p = b; p < e; ++p)
+        {
+            const size_t first = p * RayPacket::MAX_SIZE;
+            const size_t last  = std::min(n, first + RayPacket::MAX_SIZE);
+
+            packet.size = 0;
+            for (size_t i = first; i < last; ++i)
+                packet.push_back(rays_[i].ray);
+            scene_.intersect_packet(packet, hit);
+
+            for (size_t i = first; i < last; ++i)
+            {
+                const PathRay& r = rays_[i];
+                PathHit&       h = hits_[i];
+                h.pixel      = r.pixel;
+                h.object     = hit[i - first].object;
+                h.throughput = r.throughput;
+                h.direction  = r.ray.direction;
+
+                if (h.object >= 0)
+                    scene_.surface(r.ray, hit[i - first], h.point, h.normal);
+                else
+                    colors_[r.pixel] = scene_.background;
+            }
+        }
+    });
+
+    hits_.erase(std::remove_if(hits_.begin(), hits_.end(), [](const PathHit& h) { return h.object < 0; }),
+                hits_.end());
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void WavefrontRenderer::sort_hits()
+{
+    // counting sort by object index
+    std::vector<size_t> first(scene_.objects.size() + 1, 0);
+    for (const PathHit& h: hits_)
+        ++first[h.object + 1];
+    for (size_t i = 1; i < first.size(); ++i)
+        first[i] += first[i-1];
+
+    sorted_hits_.resize(hits_.size());
+    for (const PathHit& h: hits_)
+        sorted_hits_[first[h.object]++] = h;
+    hits_.swap(sorted_hits_);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void WavefrontRenderer::shade_hits(int _depth, std::vector<Bounce>& _bounces)
+{
+    const std::vector<Light>& lights = scene_.lights;
+    const size_t n = hits_.size();
+    const size_t num_lights = lights.size();
+
+    // Emit one shadow ray per hit and light into a buffer grouped by light,
+    // such that consecutive rays start at the same light and end on the
+    // same object. Lights behind the surface do not contribute, their
+    // shadow rays are skipped (tmax < 0).
+    std::vector<ShadowRay>& shadow_rays = shadow_rays_;
+    shadow_rays.resize(n * num_lights);
+    parallel_for(n, 1024, [&](size_t b, size_t e)
+    {
+        for (size_t l = 0; l < num_lights; ++l)
+        {
+            for (size_t i = b; i < e; ++i)
+            {
+                ShadowRay& s = shadow_rays[l * n + i];
+                if (scene_.faces_light(lights[l], hits_[i].point, hits_[i].normal))
+                    s.ray = scene_.shadow_ray(lights[l], hits_[i].point, hits_[i].normal, s.tmax);
+                else
+                    s.tmax = -1.0;
+            }
+        }
+    });
+
+    // test all shadow rays
+    std::vector<char>& lit = lit_;
+    lit.resize(n * num_lights);
+    std::atomic<size_t> num_shadow_rays(0);
+    parallel_for(shadow_rays.size(), 1024, [&](size_t b, size_t e)
+    {
+        size_t count = 0;
+        for (size_t i = b; i < e; ++i)
+        {
+            const ShadowRay& s = shadow_rays[i];
+            lit[i] = (s.tmax >= 0.0) && !scene_.occluded(s.ray, s.tmax);
+            count += (s.tmax >= 0.0);
+        }
+        num_shadow_rays += count;
+    });
+    statistics_[_depth].shadow_rays += num_shadow_rays;
+
+    // Local lighting in the order of Scene::lighting(), then decide whether
+    // the path ends here or continues with a reflected ray. Bounces and
+    // reflected rays are compacted afterwards: reflects[i] is 1 for a
+    // reflective hit whose path ends, 2 if the path continues.
+    std::vector<char>&    reflects  = reflects_;
+    std::vector<Bounce>&  bounces   = bounces_;
+    std::vector<PathRay>& reflected = reflected_;
+    reflects.assign(n, 0);
+    bounces.resize(n);
+    reflected.resize(n);
+    parallel_for(n, 1024, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; ++i)
+        {
+            const PathHit&  h        = hits_[i];
+            const Material& material = scene_.objects[h.object]->material;
+            const vec3      view     = -h.direction;
+
+            vec3 color = scene_.ambience * material.ambient;
+            for (size_t l = 0; l < num_lights; ++l)
+                if (lit[l * n + i])
+                    color += scene_.direct_light(lights[l], h.point, h.normal, view, material);
+
+            double reflection_rate = material.mirror;
+            if (reflection_rate < 1e-4)
+            {
+                colors_[h.pixel] = color;
+                continue;
+            }
+            bounces[i] = Bounce{h.pixel, color, reflection_rate};
+
+            const double throughput = h.throughput * reflection_rate;
+            if (_depth + 1 > scene_.max_depth || throughput < scene_.min_throughput)
+            {
+                colors_[h.pixel] = vec3(0,0,0);
+                reflects[i] = 1;
+                continue;
+            }
+
+            reflected[i].ray        = scene_.reflected_ray(h.direction, h.point, h.normal);
+            reflected[i].pixel      = h.pixel;
+            reflected[i].throughput = throughput;
+            reflects[i] = 2;
+        }
+    });
+
+    _bounces.clear();
+    rays_.clear();
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (reflects[i] > 0) _bounces.push_back(bounces[i]);
+        if (reflects[i] > 1) rays_.push_back(reflected[i]);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void WavefrontRenderer::parallel_for(size_t _n, size_t _grain,
+                                     const std::function<void(size_t, size_t)>& _func) const
+{
+    const size_t num_chunks  = (_n + _grain - 1) / _grain;
+    const size_t num_threads = std::min<size_t>(num_threads_, num_chunks);
+    if (num_threads <= 1)
+    {
+        if (_n) _func(0, _n);
+        return;
+    }
+
+    // hand out chunks dynamically, since ray costs vary a lot
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t b; (b = next.fetch_add(_grain)) < _n; )
+            _func(b, std::min(_n, b + _grain));
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& t: threads)
+        t.join();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+std::ostream& operator<<(std::ostream& _os,
+                         const std::vector<WavefrontRenderer::WaveStatistics>& _stats)
+{
+    for (size_t i = 0; i < _stats.size(); ++i)
+    {
+        _os << "  wave " << i << ": " << _stats[i].rays << " rays, "
+            << _stats[i].hits << " hits, "
+            << _stats[i].shadow_rays << " shadow rays\n";
+    }
+    return _os;
+}
+
+
+//=============================================================================
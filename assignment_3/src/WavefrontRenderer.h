@@ -0,0 +1,177 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef WAVEFRONTRENDERER_H
+#define WAVEFRONTRENDERER_H
+
+
+//== INCLUDES =================================================================
+
+#include "Scene.h"
+#include <functional>
+#include <iostream>
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class WavefrontRenderer WavefrontRenderer.h
+/// This class renders a Scene in stages ("waves") instead of tracing every
+/// pixel depth first. For a batch of pixels, all primary rays are generated
+/// into a ray buffer and intersected in packets. The hits are sorted by
+/// object, then all shadow rays of the wave are emitted into a buffer and
+/// tested together, and the reflected rays form the ray buffer of the next
+/// wave. Every stage processes its buffer in parallel. The colors of the
+/// waves are blended exactly like in Scene::shade(), so the image is
+/// identical to the one computed by Scene::render().
+class WavefrontRenderer
+{
+public:
+
+    /// number of rays, hits, and shadow rays processed in one wave
+    struct WaveStatistics
+    {
+        /// number of rays intersected
+        size_t rays = 0;
+        /// number of rays that hit an object
+        size_t hits = 0;
+        /// number of shadow rays tested for occlusion
+        size_t shadow_rays = 0;
+    };
+
+    /// Construct a renderer for \c _scene. Tile size, tile order, and number
+    /// of threads are taken from \c _settings.
+    WavefrontRenderer(Scene& _scene,
+                      const TileScheduler::Settings& _settings = TileScheduler::Settings());
+
+    /// Render the image seen by the scene's camera.
+    Image render();
+
+    /// Statistics of the last call to render(), one entry per wave, summed
+    /// over all pixel batches.
+    const std::vector<WaveStatistics>& statistics() const { return statistics_; }
+
+private:
+
+    /// a ray of the current wave
+    struct PathRay
+    {
+        /// the ray
+        Ray ray;
+        /// index of the pixel within the batch
+        int pixel;
+        /// product of the mirror weights along the path
+        double throughput;
+    };
+
+    /// the closest intersection of a PathRay
+    struct PathHit
+    {
+        /// index of the pixel within the batch
+        int pixel;
+        /// index (into Scene::objects) of the object that was hit
+        int object;
+        /// product of the mirror weights along the path
+        double throughput;
+        /// direction of the ray that hit the object
+        vec3 direction;
+        /// intersection point and surface normal
+        vec3 point, normal;
+    };
+
+    /// a shadow ray from a light to a hit
+    struct ShadowRay
+    {
+        /// the ray, see Scene::shadow_ray()
+        Ray ray;
+        /// only intersections in (0, tmax) occlude the light
+        double tmax;
+    };
+
+    /// a reflective hit, blended with the color of the next wave
+    struct Bounce
+    {
+        /// index of the pixel within the batch
+        int pixel;
+        /// local Phong lighting at the hit
+        vec3 color;
+        /// mirror weight of the hit material
+        double mirror;
+    };
+
+    /// Render the pixels [\c _begin, \c _end) of pixels_ into \c _img.
+    void render_batch(size_t _begin, size_t _end, Image& _img);
+
+    /// Intersect rays_ with the scene, append the hits to hits_ and store
+    /// the background color for the rays that miss.
+    void intersect_rays();
+
+    /// Reorder hits_ by object index (stable, i.e., by pixel within an object).
+    void sort_hits();
+
+    /// Compute the local lighting of all hits with shadow rays tested in
+    /// bulk, record reflective hits in \c _bounces, and emit the reflected
+    /// rays of the next wave into rays_.
+    void shade_hits(int _depth, std::vector<Bounce>& _bounces);
+
+    /// Call \c _func(begin, end) for consecutive ranges of at most \c _grain
+    /// indices covering [0, \c _n), distributed over all threads.
+    void parallel_for(size_t _n, size_t _grain,
+                      const std::function<void(size_t, size_t)>& _func) const;
+
+private:
+
+    /// the scene to render
+    Scene& scene_;
+
+    /// tile settings, determine the pixel order
+    TileScheduler::Settings settings_;
+
+    /// number of threads
+    unsigned int num_threads_;
+
+    /// pixel coordinates, in tile order
+    std::vector<std::pair<unsigned int, unsigned int>> pixels_;
+
+    /// color of the current batch's pixels, blended from the last wave to the first
+    std::vector<vec3> colors_;
+
+    /// rays of the current wave
+    std::vector<PathRay> rays_;
+
+    /// hits of the current wave
+    std::vector<PathHit> hits_;
+
+    /// Buffers of the stages, kept allocated between waves and batches,
+    /// see sort_hits() and shade_hits()
+    std::vector<PathHit>   sorted_hits_;
+    std::vector<ShadowRay> shadow_rays_;
+    std::vector<char>      lit_;
+    std::vector<char>      reflects_;
+    std::vector<Bounce>    bounces_;
+    std::vector<PathRay>   reflected_;
+
+    /// statistics, one entry per wave
+    std::vector<WaveStatistics> statistics_;
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+/// output the per-wave statistics of a wavefront render
+std::ostream& operator<<(std::ostream& _os,
+                         const std::vector<WavefrontRenderer::WaveStatistics>& _stats);
+
+
+//=============================================================================
+#endif // WAVEFRONTRENDERER_H defined
+//=============================================================================
@@ -0,0 +1,148 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== includes =================================================================
+
+#include "StopWatch.h"
+#include "Scene.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/// Run \c _func \c _repetitions times and return the fastest time in ms.
+template <class Func>
+static double best_time(int _repetitions, const Func& _func)
+{
+    double best = std::numeric_limits<double>::infinity();
+    for (int r = 0; r < _repetitions; ++r)
+    {
+        StopWatch timer;
+        timer.start();
+        _func();
+        best = std::min(best, timer.stop());
+    }
+    return best;
+}
+
+
+/// Rebuild all hierarchies of \c _scene: those of its meshes and those over
+/// its objects, with the current Mesh::bvh_method and Scene::bvh_method.
+static void build_all(Scene& _scene)
+{
+    for (const auto& object: _scene.getObjects())
+        if (Mesh* mesh = dynamic_cast<Mesh*>(object.get()))
+            mesh->build_bvh();
+    _scene.build_bvh();
+}
+
+
+/// Are the colors of all pixels of \c _a and \c _b identical?
+static bool same_image(const Image& _a, const Image& _b)
+{
+    if (_a.width() != _b.width() || _a.height() != _b.height()) return false;
+    for (unsigned int y = 0; y < _a.height(); ++y)
+        for (unsigned int x = 0; x < _a.width(); ++x)
+            for (int c = 0; c < 3; ++c)
+                if (_a(x, y)[c] != _b(x, y)[c]) return false;
+    return true;
+}
+
+
+/// Program entry point.
+int main(int argc, char **argv) {
+    // Parse the scene files and options from command line arguments
+    std::vector<std::string> files;
+    int repetitions = 3;
+    TileScheduler::Settings settings;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        const bool hasValue = (i + 1 < argc);
+        if      (arg == "--repeat"  && hasValue) repetitions          = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--threads" && hasValue) settings.num_threads = std::stoi(argv[++i]);
+        else if (arg[0] == '-') {
+            std::cerr << "Usage: " << argv[0] << " [--repeat N] [--threads N] [scene.sce ...]\n";
+            std::cerr << "Without files, the bundled scenes are read.\n";
+            exit(1);
+        }
+        else files.push_back(arg);
+    }
+
+    if (files.empty()) {
+        files = {
+            "../scenes/spheres/spheres.sce",
+            "../scenes/cylinders/cylinders.sce",
+            "../scenes/combo/combo.sce",
+            "../scenes/molecule/molecule.sce",
+            "../scenes/molecule2/molecule2.sce",
+            "../scenes/cube/cube.sce",
+            "../scenes/mask/mask.sce",
+            "../scenes/mirror/mirror.sce",
+            "../scenes/rings/rings.sce",
+            "../scenes/toon_faces/toon_faces.sce",
+            "../scenes/office/office.sce"
+        };
+    }
+
+    // the hierarchies are built by this program, not read from the caches
+    Mesh::cache_enabled = false;
+
+    const BVH::Method methods[] = { BVH::MEDIAN, BVH::SAH };
+
+    std::cout << "build: all hierarchies of the scene, trace: rendering the image; best of "
+              << repetitions << " runs, times in ms\n";
+    std::cout << std::left  << std::setw(40) << "scene"
+              << std::right << std::setw(12) << "fast build"
+              << std::setw(12) << "fast trace"
+              << std::setw(12) << "qual build"
+              << std::setw(12) << "qual trace" << "\n";
+
+    bool all_equal = true;
+
+    for (const std::string& filename : files) {
+        // the scene prints progress while reading, which is not shown here
+        std::ostringstream log;
+        std::streambuf* cout_buffer = std::cout.rdbuf(log.rdbuf());
+        Scene scene(filename);
+        std::cout.rdbuf(cout_buffer);
+
+        std::cout << std::left  << std::setw(40) << filename
+                  << std::right << std::fixed << std::setprecision(3);
+
+        // both builds have to render the same image
+        Image reference;
+        bool  equal = true;
+        for (BVH::Method method: methods) {
+            Mesh::bvh_method  = method;
+            Scene::bvh_method = method;
+
+            const double t_build = best_time(repetitions, [&]() { build_all(scene); });
+
+            Image image;
+            const double t_trace = best_time(repetitions, [&]() { image = scene.render(settings); });
+            if (reference.width() == 0) reference = image;
+            else equal = equal && same_image(reference, image);
+
+            std::cout << std::setw(12) << t_build << std::setw(12) << t_trace << std::flush;
+        }
+        all_equal = all_equal && equal;
+
+        std::cout << (equal ? "" : "  MISMATCH") << "\n";
+    }
+
+    return all_equal ? 0 : 1;
+}
@@ -0,0 +1,631 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== includes =================================================================
+
+#include "StopWatch.h"
+#include "Sphere.h"
+#include "Cylinder.h"
+#include "Plane.h"
+#include "PrimitiveArrays.h"
+#include "Mesh.h"
+#include "SolveQuadratic.h"
+#include "TriangleIntersection.h"
+#include "Ray.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+
+/// Every ray is tested against a batch of this many primitives, such that
+/// the SIMD kernels (up to 8 lanes) and the scalar kernels perform the same
+/// ray-primitive tests.
+static const int BATCH = 8;
+
+
+/// Run \c _func \c _repetitions times and return the fastest time in ms.
+template <class Func>
+static double best_time(int _repetitions, const Func& _func)
+{
+    double best = std::numeric_limits<double>::infinity();
+    for (int r = 0; r < _repetitions; ++r)
+    {
+        StopWatch timer;
+        timer.start();
+        _func();
+        best = std::min(best, timer.stop());
+    }
+    return best;
+}
+
+
+/// Random rays and primitives placed relative to them, such that a given
+/// fraction of the tests hits.
+class TestSet
+{
+public:
+
+    /// \c _tests tests, i.e., \c _tests / BATCH rays, with hit ratio \c _hit_ratio
+    TestSet(int _tests, double _hit_ratio)
+    : rng_(42)
+    {
+        std::uniform_real_distribution<double> coordinate(-10.0, 10.0);
+        for (int i = 0; i < _tests / BATCH; ++i)
+            rays.push_back(Ray(vec3(coordinate(rng_), coordinate(rng_), coordinate(rng_)), random_direction()));
+        for (int i = 0; i < _tests; ++i)
+            hits.push_back(uniform(0.0, 1.0) < _hit_ratio);
+    }
+
+    /// number of tests
+    int size() const { return int(hits.size()); }
+
+    /// the ray of test \c _i
+    const Ray& ray(int _i) const { return rays[_i / BATCH]; }
+
+    /// uniformly distributed random number in [\c _lo, \c _hi)
+    double uniform(double _lo, double _hi)
+    {
+        return std::uniform_real_distribution<double>(_lo, _hi)(rng_);
+    }
+
+    /// uniformly distributed random unit vector
+    vec3 random_direction()
+    {
+        const double z   = uniform(-1.0, 1.0);
+        const double phi = uniform(0.0, 2.0 * M_PI);
+        const double r   = std::sqrt(1.0 - z * z);
+        return vec3(r * std::cos(phi), r * std::sin(phi), z);
+    }
+
+    /// random unit vector perpendicular to the unit vector \c _d
+    vec3 perpendicular(const vec3& _d)
+    {
+        vec3 v;
+        do { v = random_direction(); v = v - dot(v, _d) * _d; } while (norm(v) < 1e-3);
+        return normalize(v);
+    }
+
+public:
+
+    /// the rays, one per BATCH tests
+    std::vector<Ray> rays;
+    /// should test i hit?
+    std::vector<bool> hits;
+
+private:
+
+    std::mt19937 rng_;
+};
+
+
+/// Prints one line per kernel and variant.
+class Report
+{
+public:
+
+    Report(int _repetitions) : repetitions_(_repetitions)
+    {
+        std::cout << std::left  << std::setw(26) << "kernel"
+                  << std::setw(22) << "variant"
+                  << std::right << std::setw(10) << "ns/test"
+                  << std::setw(14) << "Mtests/s"
+                  << std::setw(10) << "hits" << "\n";
+    }
+
+    /// Measure \c _func, which performs \c _tests tests and returns the
+    /// number of hits.
+    template <class Func>
+    void run(const std::string& _kernel, const std::string& _variant, int _tests, const Func& _func)
+    {
+        int hits = 0;
+        const double ms = best_time(repetitions_, [&]() { hits = _func(); });
+
+        std::cout << std::left  << std::setw(26) << _kernel
+                  << std::setw(22) << _variant
+                  << std::right << std::fixed
+                  << std::setw(10) << std::setprecision(2) << ms * 1e6 / _tests
+                  << std::setw(14) << std::setprecision(1) << _tests / (ms * 1e3)
+                  << std::setw(9)  << std::setprecision(1) << 100.0 * hits / _tests << "%"
+                  << std::endl;
+    }
+
+private:
+
+    int repetitions_;
+};
+
+
+//== solveQuadratic ===========================================================
+
+
+/// Coefficients of quadratic equations, two real roots for a hit and a
+/// pair of complex roots for a miss.
+template <class Scalar>
+struct Quadratics
+{
+    std::vector<Scalar> a, b, c;
+};
+
+
+template <class Scalar>
+static Quadratics<Scalar> make_quadratics(TestSet& _set)
+{
+    Quadratics<Scalar> q;
+    for (int i = 0; i < _set.size(); ++i)
+    {
+        const double a  = _set.uniform(0.5, 2.0);
+        const double r0 = _set.uniform(-10.0, 10.0);
+        const double r1 = _set.uniform(-10.0, 10.0);
+        q.a.push_back(Scalar(a));
+        if (_set.hits[i])
+        {
+            // roots r0 and r1
+            q.b.push_back(Scalar(-a * (r0 + r1)));
+            q.c.push_back(Scalar(a * r0 * r1));
+        }
+        else
+        {
+            // roots r0 +- i |r1|
+            q.b.push_back(Scalar(-2.0 * a * r0));
+            q.c.push_back(Scalar(a * (r0 * r0 + r1 * r1)));
+        }
+    }
+    return q;
+}
+
+
+template <class Scalar>
+static void bench_quadratic(Report& _report, TestSet& _set, const std::string& _precision)
+{
+    const Quadratics<Scalar> q = make_quadratics<Scalar>(_set);
+    const int n = _set.size();
+
+    // both variants store the solutions, such that they have to be computed
+    std::vector<Scalar> x0(n), x1(n);
+    _report.run("solveQuadratic", "scalar " + _precision, n, [&]()
+    {
+        int hits = 0;
+        std::array<Scalar, 2> s{};
+        for (int i = 0; i < n; ++i)
+        {
+            const size_t k = solveQuadratic(q.a[i], q.b[i], q.c[i], s);
+            x0[i] = s[0];
+            x1[i] = s[1];
+            hits += (k == 2);
+        }
+        return hits;
+    });
+
+    _report.run("solveQuadraticSelect", "SIMD loop " + _precision, n, [&]()
+    {
+        for (int i = 0; i < n; ++i)
+            solveQuadraticSelect(q.a[i], q.b[i], q.c[i], x0[i], x1[i]);
+        int hits = 0;
+        for (int i = 0; i < n; ++i)
+            hits += (x1[i] == x1[i]);
+        return hits;
+    });
+}
+
+
+//== objects ==================================================================
+
+
+/// Spheres around the rays: the distance of the center to the ray is
+/// smaller than the radius for a hit, larger for a miss. The spheres are
+/// also stored in \c _arrays.
+template <class Scalar>
+static std::vector<std::unique_ptr<Object>> make_spheres(TestSet& _set, PrimitiveArrays::SphereArrays<Scalar>& _arrays)
+{
+    std::vector<std::unique_ptr<Object>> spheres;
+    for (int i = 0; i < _set.size(); ++i)
+    {
+        const Ray&   ray = _set.ray(i);
+        const double r   = _set.uniform(0.5, 2.0);
+        const double d   = _set.hits[i] ? _set.uniform(0.0, 0.95) * r : _set.uniform(1.05, 3.0) * r;
+        const vec3   c   = ray(_set.uniform(5.0, 50.0)) + d * _set.perpendicular(ray.direction);
+        spheres.emplace_back(new Sphere(c, r));
+
+        for (int k = 0; k < 3; ++k) _arrays.center[k].push_back(Scalar(c[k]));
+        _arrays.radius.push_back(Scalar(r));
+    }
+    return spheres;
+}
+
+
+/// Cylinders crossing the rays: the axis is perpendicular to the ray, and
+/// the distance of the axis to the ray is smaller than the radius for a hit,
+/// larger for a miss. The cylinders are also stored in \c _arrays.
+template <class Scalar>
+static std::vector<std::unique_ptr<Object>> make_cylinders(TestSet& _set, PrimitiveArrays::CylinderArrays<Scalar>& _arrays)
+{
+    std::vector<std::unique_ptr<Object>> cylinders;
+    for (int i = 0; i < _set.size(); ++i)
+    {
+        const Ray&   ray    = _set.ray(i);
+        const double r      = _set.uniform(0.5, 2.0);
+        const vec3   axis   = _set.perpendicular(ray.direction);
+        const vec3   offset = normalize(cross(axis, ray.direction));
+        const double d      = _set.hits[i] ? _set.uniform(0.0, 0.95) * r : _set.uniform(1.05, 3.0) * r;
+        const vec3   c      = ray(_set.uniform(5.0, 50.0)) + d * offset;
+        const double h      = _set.uniform(1.0, 4.0);
+        cylinders.emplace_back(new Cylinder(c, r, axis, h));
+
+        // the half height is computed like in PrimitiveArrays
+        for (int k = 0; k < 3; ++k)
+        {
+            _arrays.center[k].push_back(Scalar(c[k]));
+            _arrays.axis[k]  .push_back(Scalar(axis[k]));
+        }
+        _arrays.radius.push_back(Scalar(r));
+        _arrays.half_height.push_back(Scalar(h / 2));
+    }
+    return cylinders;
+}
+
+
+/// Planes in front of the rays for a hit, behind them for a miss. The
+/// planes are also stored in \c _arrays.
+template <class Scalar>
+static std::vector<std::unique_ptr<Object>> make_planes(TestSet& _set, PrimitiveArrays::PlaneArrays<Scalar>& _arrays)
+{
+    std::vector<std::unique_ptr<Object>> planes;
+    for (int i = 0; i < _set.size(); ++i)
+    {
+        const Ray&   ray = _set.ray(i);
+        const double t   = _set.uniform(5.0, 50.0) * (_set.hits[i] ? 1.0 : -1.0);
+        vec3 n = _set.random_direction();
+        if (std::abs(dot(n, ray.direction)) < 0.1) n = ray.direction;
+        planes.emplace_back(new Plane(ray(t), n));
+
+        for (int k = 0; k < 3; ++k)
+        {
+            _arrays.center[k].push_back(Scalar(ray(t)[k]));
+            _arrays.normal[k].push_back(Scalar(n[k]));
+        }
+    }
+    return planes;
+}
+
+
+/// Intersect all tests through the virtual Object interface, like Scene.
+template <class Scalar>
+static int intersect_objects(const TestSet& _set, const std::vector<std::unique_ptr<Object>>& _objects,
+                             const std::vector<RayT<Scalar>>& _rays)
+{
+    int hits = 0;
+    for (int i = 0; i < _set.size(); ++i)
+    {
+        HitT<Scalar> hit;
+        hits += _objects[i]->intersect(_rays[i / BATCH], hit);
+    }
+    return hits;
+}
+
+
+/// The rays of \c _set in precision \c Scalar
+template <class Scalar>
+static std::vector<RayT<Scalar>> convert_rays(const TestSet& _set)
+{
+    std::vector<RayT<Scalar>> rays;
+    for (const Ray& ray: _set.rays)
+        rays.push_back(RayT<Scalar>(ray));
+    return rays;
+}
+
+
+/// The origins and directions of \c _rays as arrays, as passed to the
+/// kernels of PrimitiveArrays
+template <class Scalar>
+static void ray_arrays(const std::vector<RayT<Scalar>>& _rays, std::vector<Scalar>& _o, std::vector<Scalar>& _d)
+{
+    for (const RayT<Scalar>& ray: _rays)
+        for (int c = 0; c < 3; ++c)
+        {
+            _o.push_back(ray.origin[c]);
+            _d.push_back(ray.direction[c]);
+        }
+}
+
+
+template <class Scalar>
+static void bench_objects(Report& _report, TestSet& _spheres_set, TestSet& _cylinders_set, TestSet& _planes_set,
+                          const std::string& _precision)
+{
+    typedef PrimitiveArrays PA;
+
+    // spheres
+    {
+        TestSet& set = _spheres_set;
+        PA::SphereArrays<Scalar> s;
+        const std::vector<std::unique_ptr<Object>> objects = make_spheres(set, s);
+        const std::vector<RayT<Scalar>> rays = convert_rays<Scalar>(set);
+        std::vector<Scalar> o, d;
+        ray_arrays(rays, o, d);
+
+        _report.run("Sphere::intersect", "virtual " + _precision, set.size(), [&]()
+        {
+            return intersect_objects(set, objects, rays);
+        });
+
+        const int LANES = PA::SphereLanes<Scalar>::value;
+        _report.run("intersect_sphere_lanes", "SIMD x" + std::to_string(LANES) + " " + _precision, set.size(), [&]()
+        {
+            int hits = 0;
+            Scalar t[BATCH];
+            for (int first = 0; first < set.size(); first += LANES)
+            {
+                const int r = first / BATCH;
+                PA::intersect_sphere_lanes(s, first, &o[3*r], &d[3*r], t);
+                for (int k = 0; k < LANES; ++k)
+                    hits += (t[k] < std::numeric_limits<Scalar>::infinity());
+            }
+            return hits;
+        });
+    }
+
+    // cylinders
+    {
+        TestSet& set = _cylinders_set;
+        PA::CylinderArrays<Scalar> cy;
+        const std::vector<std::unique_ptr<Object>> objects = make_cylinders(set, cy);
+        const std::vector<RayT<Scalar>> rays = convert_rays<Scalar>(set);
+        std::vector<Scalar> o, d;
+        ray_arrays(rays, o, d);
+
+        _report.run("Cylinder::intersect", "virtual " + _precision, set.size(), [&]()
+        {
+            return intersect_objects(set, objects, rays);
+        });
+
+        _report.run("intersect_cylinder", "arrays " + _precision, set.size(), [&]()
+        {
+            int hits = 0;
+            for (int i = 0; i < set.size(); ++i)
+            {
+                const int r = i / BATCH;
+                hits += (PA::intersect_cylinder(cy, i, &o[3*r], &d[3*r]) < std::numeric_limits<Scalar>::infinity());
+            }
+            return hits;
+        });
+    }
+
+    // planes
+    {
+        TestSet& set = _planes_set;
+        PA::PlaneArrays<Scalar> p;
+        const std::vector<std::unique_ptr<Object>> objects = make_planes(set, p);
+        const std::vector<RayT<Scalar>> rays = convert_rays<Scalar>(set);
+        std::vector<Scalar> o, d;
+        ray_arrays(rays, o, d);
+
+        _report.run("Plane::intersect", "virtual " + _precision, set.size(), [&]()
+        {
+            return intersect_objects(set, objects, rays);
+        });
+
+        _report.run("intersect_plane", "arrays " + _precision, set.size(), [&]()
+        {
+            int hits = 0;
+            for (int i = 0; i < set.size(); ++i)
+            {
+                const int r = i / BATCH;
+                hits += (PA::intersect_plane(p, i, &o[3*r], &d[3*r]) < std::numeric_limits<Scalar>::infinity());
+            }
+            return hits;
+        });
+    }
+}
+
+
+//== triangles ================================================================
+
+
+/// Triangles around the rays: the ray passes through the triangle for a
+/// hit, and at a distance larger than its circumradius for a miss. The
+/// arrays are padded like those of Mesh.
+template <class Scalar>
+static Mesh::TriangleArrays<Scalar> make_triangles(TestSet& _set)
+{
+    Mesh::TriangleArrays<Scalar> tri;
+    for (int i = 0; i < _set.size(); ++i)
+    {
+        const Ray&   ray = _set.ray(i);
+        const double r   = _set.uniform(0.5, 2.0);
+        const vec3   u   = _set.perpendicular(ray.direction);
+        const vec3   v   = normalize(cross(ray.direction, u));
+        const vec3   w   = normalize(ray.direction + _set.uniform(-0.5, 0.5) * u);
+
+        // vertices on a circle of radius r around the center c, which is
+        // close to the ray for a hit (inside the inscribed circle of
+        // radius r/2 of an equilateral triangle)
+        const double d = _set.hits[i] ? _set.uniform(0.0, 0.45) * r : _set.uniform(1.05, 3.0) * r;
+        const vec3   c = ray(_set.uniform(5.0, 50.0)) + d * v;
+        const vec3   e = normalize(cross(w, v));
+        const double phi = _set.uniform(0.0, 2.0 * M_PI);
+        vec3 p[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            const double a = phi + k * 2.0 * M_PI / 3.0;
+            p[k] = c + r * (std::cos(a) * v + std::sin(a) * e);
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            tri.v0[c].push_back(Scalar(p[0][c]));
+            tri.v1[c].push_back(Scalar(p[1][c]));
+            tri.v2[c].push_back(Scalar(p[2][c]));
+        }
+        tri.index.push_back(i);
+    }
+    for (int c = 0; c < 3; ++c)
+    {
+        tri.v0[c].resize(_set.size() + Mesh::LANES - 1, Scalar(0));
+        tri.v1[c].resize(_set.size() + Mesh::LANES - 1, Scalar(0));
+        tri.v2[c].resize(_set.size() + Mesh::LANES - 1, Scalar(0));
+    }
+    tri.index.resize(_set.size() + Mesh::LANES - 1, -1);
+    return tri;
+}
+
+
+template <class Scalar>
+static void bench_triangles(Report& _report, TestSet& _set, const std::string& _precision)
+{
+    const Mesh::TriangleArrays<Scalar> tri = make_triangles<Scalar>(_set);
+    const std::vector<RayT<Scalar>> rays = convert_rays<Scalar>(_set);
+
+    // the per-ray constants are computed once per ray, like in Mesh
+    std::vector<WatertightRay<Scalar>> wrays;
+    for (const RayT<Scalar>& ray: rays)
+        wrays.push_back(WatertightRay<Scalar>(ray));
+
+    _report.run("intersect_triangle", "scalar " + _precision, _set.size(), [&]()
+    {
+        int hits = 0;
+        for (int i = 0; i < _set.size(); ++i)
+        {
+            const WatertightRay<Scalar>& ray = wrays[i / BATCH];
+            Scalar t, alpha, beta;
+            hits += intersect_triangle_watertight(ray,
+                                                  tri.v0[ray.kx][i], tri.v0[ray.ky][i], tri.v0[ray.kz][i],
+                                                  tri.v1[ray.kx][i], tri.v1[ray.ky][i], tri.v1[ray.kz][i],
+                                                  tri.v2[ray.kx][i], tri.v2[ray.ky][i], tri.v2[ray.kz][i],
+                                                  t, alpha, beta);
+        }
+        return hits;
+    });
+
+    _report.run("intersect_triangle_lanes", "SIMD x" + std::to_string(Mesh::LANES) + " " + _precision, _set.size(), [&]()
+    {
+        int hits = 0;
+        Scalar t[Mesh::LANES], alpha[Mesh::LANES], beta[Mesh::LANES];
+        bool   hit[Mesh::LANES];
+        for (int first = 0; first < _set.size(); first += Mesh::LANES)
+        {
+            Mesh::intersect_triangle_lanes(tri, wrays[first / BATCH], first, t, alpha, beta, hit);
+            for (int k = 0; k < Mesh::LANES; ++k)
+                hits += hit[k];
+        }
+        return hits;
+    });
+}
+
+
+//== boxes ====================================================================
+
+
+/// Boxes around the rays: centered on the ray for a hit, and further away
+/// from it than their half diagonal for a miss.
+static void make_boxes(TestSet& _set, std::vector<vec3>& _bb_min, std::vector<vec3>& _bb_max)
+{
+    for (int i = 0; i < _set.size(); ++i)
+    {
+        const Ray&   ray = _set.ray(i);
+        const vec3   h(_set.uniform(0.5, 2.0), _set.uniform(0.5, 2.0), _set.uniform(0.5, 2.0));
+        const double d   = _set.hits[i] ? 0.0 : _set.uniform(1.05, 3.0) * norm(h);
+        const vec3   c   = ray(_set.uniform(5.0, 50.0)) + d * _set.perpendicular(ray.direction);
+        _bb_min.push_back(c - h);
+        _bb_max.push_back(c + h);
+    }
+}
+
+
+template <class Scalar>
+static void bench_boxes(Report& _report, TestSet& _set, const std::string& _precision)
+{
+    std::vector<vec3> bb_min, bb_max;
+    make_boxes(_set, bb_min, bb_max);
+    const std::vector<RayT<Scalar>> rays = convert_rays<Scalar>(_set);
+
+    // boxes are stored like the nodes of BVH, rounded outwards to float
+    std::vector<std::array<float, 3>> fmin(_set.size()), fmax(_set.size());
+    for (int i = 0; i < _set.size(); ++i)
+        for (int c = 0; c < 3; ++c)
+        {
+            fmin[i][c] = std::nextafter(float(bb_min[i][c]), -std::numeric_limits<float>::infinity());
+            fmax[i][c] = std::nextafter(float(bb_max[i][c]),  std::numeric_limits<float>::infinity());
+        }
+
+    _report.run("intersect_box", "BVH node " + _precision, _set.size(), [&]()
+    {
+        int hits = 0;
+        for (int i = 0; i < _set.size(); ++i)
+        {
+            Scalar tmin = 0, tmax = std::numeric_limits<Scalar>::infinity();
+            hits += rays[i / BATCH].intersect_box(fmin[i], fmax[i], tmin, tmax);
+        }
+        return hits;
+    });
+}
+
+
+//=============================================================================
+
+
+/// Program entry point.
+int main(int argc, char **argv) {
+    // Parse the options from command line arguments
+    int repetitions  = 10;
+    int tests        = 1 << 16;
+    double hit_ratio = 0.5;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        const bool hasValue = (i + 1 < argc);
+        if      (arg == "--repeat"    && hasValue) repetitions = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--tests"     && hasValue) tests       = std::max(BATCH, std::stoi(argv[++i]));
+        else if (arg == "--hit-ratio" && hasValue) hit_ratio   = std::stod(argv[++i]);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--repeat N] [--tests N] [--hit-ratio R]\n";
+            exit(1);
+        }
+    }
+    tests = tests / BATCH * BATCH;
+
+    std::cout << tests << " tests per kernel (" << tests / BATCH << " rays, " << BATCH
+              << " primitives per ray), " << 100.0 * hit_ratio << "% hits requested; best of "
+              << repetitions << " runs\n";
+    Report report(repetitions);
+
+    // every kernel gets its own random set, both precisions test the same
+    // rays and primitives
+    TestSet quadratics(tests, hit_ratio);
+    bench_quadratic<double>(report, quadratics, "double");
+    TestSet quadratics_float(tests, hit_ratio);
+    bench_quadratic<float>(report, quadratics_float, "float");
+
+    for (int precision = 0; precision < 2; ++precision) {
+        TestSet spheres(tests, hit_ratio), cylinders(tests, hit_ratio), planes(tests, hit_ratio);
+        if (precision == 0) bench_objects<double>(report, spheres, cylinders, planes, "double");
+        else                bench_objects<float> (report, spheres, cylinders, planes, "float");
+    }
+
+    for (int precision = 0; precision < 2; ++precision) {
+        TestSet triangles(tests, hit_ratio);
+        if (precision == 0) bench_triangles<double>(report, triangles, "double");
+        else                bench_triangles<float> (report, triangles, "float");
+    }
+
+    for (int precision = 0; precision < 2; ++precision) {
+        TestSet boxes(tests, hit_ratio);
+        if (precision == 0) bench_boxes<double>(report, boxes, "double");
+        else                bench_boxes<float> (report, boxes, "float");
+    }
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== includes =================================================================
+
+#include "StopWatch.h"
+#include "MappedFile.h"
+#include "OffReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+
+/// Read an OFF file with iostreams, the way Mesh::read() used to.
+static bool read_off_stream(const std::string& _filename,
+                            std::vector<vec3>& _positions, std::vector<int>& _indices)
+{
+    std::ifstream ifs(_filename);
+    if (!ifs) return false;
+
+    std::string s;
+    unsigned int nV, nF, dummy, i;
+    ifs >> s;
+    if (s != "OFF") return false;
+    ifs >> nV >> nF >> dummy;
+
+    vec3 p;
+    _positions.clear();
+    _positions.reserve(nV);
+    for (i=0; i<nV; ++i)
+    {
+        ifs >> p;
+        _positions.push_back(p);
+    }
+
+    int i0, i1, i2;
+    _indices.clear();
+    _indices.reserve(3*nF);
+    for (i=0; i<nF; ++i)
+    {
+        ifs >> dummy >> i0 >> i1 >> i2;
+        _indices.push_back(i0);
+        _indices.push_back(i1);
+        _indices.push_back(i2);
+    }
+
+    return bool(ifs);
+}
+
+
+/// Run \c _func \c _repetitions times and return the fastest time in ms.
+template <class Func>
+static double best_time(int _repetitions, const Func& _func)
+{
+    double best = std::numeric_limits<double>::infinity();
+    for (int r = 0; r < _repetitions; ++r)
+    {
+        StopWatch timer;
+        timer.start();
+        _func();
+        best = std::min(best, timer.stop());
+    }
+    return best;
+}
+
+
+/// Program entry point.
+int main(int argc, char **argv) {
+    // Parse the OFF files and options from command line arguments
+    std::vector<std::string> files;
+    int repetitions = 10;
+    unsigned int threads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        const bool hasValue = (i + 1 < argc);
+        if      (arg == "--repeat"  && hasValue) repetitions = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--threads" && hasValue) threads     = std::stoi(argv[++i]);
+        else if (arg[0] == '-') {
+            std::cerr << "Usage: " << argv[0] << " [--repeat N] [--threads N] [file.off ...]\n";
+            std::cerr << "Without files, the meshes of the bundled scenes are read.\n";
+            exit(1);
+        }
+        else files.push_back(arg);
+    }
+
+    if (files.empty()) {
+        files = {
+            "../scenes/cube/cube.off",
+            "../scenes/mask/mask.off",
+            "../scenes/office/boden.off",
+            "../scenes/office/fenster.off",
+            "../scenes/office/glas.off",
+            "../scenes/office/griffe.off",
+            "../scenes/office/heizung.off",
+            "../scenes/office/saeulen.off",
+            "../scenes/office/schraenke.off",
+            "../scenes/office/stuhl_beine.off",
+            "../scenes/office/stuhl_polster.off",
+            "../scenes/office/tisch.off",
+            "../scenes/office/tisch_beine.off",
+            "../scenes/office/wand.off",
+            "../scenes/rings/ring1.off",
+            "../scenes/rings/ring2.off",
+            "../scenes/toon_faces/confused.off",
+            "../scenes/toon_faces/kiss.off",
+            "../scenes/toon_faces/neutral.off",
+            "../scenes/toon_faces/puff.off",
+            "../scenes/toon_faces/sad.off",
+            "../scenes/toon_faces/smile.off"
+        };
+    }
+
+    std::cout << "best of " << repetitions << " runs, times in ms\n";
+    std::cout << std::left  << std::setw(40) << "file"
+              << std::right << std::setw(12) << "iostream"
+              << std::setw(12) << "1 thread"
+              << std::setw(12) << "threaded"
+              << std::setw(10) << "speedup" << "\n";
+
+    double total_stream = 0.0, total_single = 0.0, total_threaded = 0.0;
+    bool all_equal = true;
+
+    for (const std::string& filename : files) {
+        std::vector<vec3> positions;
+        std::vector<int>  indices;
+        if (!read_off_stream(filename, positions, indices)) {
+            std::cerr << "Can't read " << filename << "\n";
+            continue;
+        }
+
+        // the file is mapped once, such that only parsing is measured
+        // (the iostream reader includes opening the file)
+        MappedFile file(filename);
+        OffReader  reader;
+        if (!file.is_open() || !reader.read(file.data(), file.size())) {
+            std::cerr << "Can't parse " << filename << ": " << reader.error() << "\n";
+            continue;
+        }
+
+        // the results have to be bitwise identical
+        const bool equal =
+            reader.positions().size() == positions.size() &&
+            reader.indices() == indices &&
+            std::memcmp(reader.positions().data(), positions.data(), positions.size() * sizeof(vec3)) == 0;
+        all_equal = all_equal && equal;
+
+        const double t_stream   = best_time(repetitions, [&]() { read_off_stream(filename, positions, indices); });
+        const double t_single   = best_time(repetitions, [&]() { reader.read(file.data(), file.size(), 1); });
+        const double t_threaded = best_time(repetitions, [&]() { reader.read(file.data(), file.size(), threads); });
+        total_stream   += t_stream;
+        total_single   += t_single;
+        total_threaded += t_threaded;
+
+        std::cout << std::left  << std::setw(40) << filename
+                  << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(12) << t_stream
+                  << std::setw(12) << t_single
+                  << std::setw(12) << t_threaded
+                  << std::setw(9)  << std::setprecision(1) << t_stream / std::min(t_single, t_threaded) << "x"
+                  << (equal ? "" : "  MISMATCH") << "\n";
+    }
+
+    std::cout << std::left  << std::setw(40) << "total"
+              << std::right << std::fixed << std::setprecision(3)
+              << std::setw(12) << total_stream
+              << std::setw(12) << total_single
+              << std::setw(12) << total_threaded
+              << std::setw(9)  << std::setprecision(1) << total_stream / std::min(total_single, total_threaded) << "x\n";
+
+    return all_equal ? 0 : 1;
+}
@@ -12,21 +12,231 @@
 
 #include "StopWatch.h"
 #include "Scene.h"
+#include "Mesh.h"
+#include "CameraPath.h"
+#include "WavefrontRenderer.h"
+#include "Statistics.h"
+#include "Profiler.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <vector>
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+/// Options controlling how a scene is rendered.
+struct RenderOptions {
+    TileScheduler::Settings settings;
+    int packetSize = 1;
+    double minThroughput = -1.0;
+    bool wavefront = false;
+    Scene::Precision precision = Scene::DOUBLE_PRECISION;
+    bool compare = false;
+    Image::ToneMapping toneMapping;
+};
+
+/// Apply \c options to the scene \c s and render it, printing the render
+/// statistics to \c log after the time \c timer it took.
+Image renderScene(Scene &s, const RenderOptions &options, StopWatch &timer, std::ostream *log) {
+    if (options.minThroughput >= 0.0) s.setMinThroughput(options.minThroughput);
+
+    WavefrontRenderer wavefrontRenderer(s, options.settings);
+    timer.start();
+    Image image;
+    {
+        Statistics::PhaseTimer phase(Statistics::RENDER);
+        image = options.wavefront ? wavefrontRenderer.render()
+                                  : s.render(options.settings, options.packetSize, options.precision);
+    }
+    timer.stop();
+
+    if (log) {
+        *log << " done (" << timer << ")\n";
+        if (options.wavefront) *log << wavefrontRenderer.statistics();
+        else                   *log << s.getRenderStatistics();
+    }
+    return image;
+}
+
+/// Compare the 8-bit colors written for images \c a and \c b with the tone
+/// mapping \c toneMapping. Returns the maximum difference of a color channel
+/// and stores the number of pixels that differ in any channel in \c numDiffering.
+int compareImages(const Image &a, const Image &b, const Image::ToneMapping &toneMapping,
+                  size_t &numDiffering) {
+    const std::vector<unsigned char> qa = a.quantize(toneMapping);
+    const std::vector<unsigned char> qb = b.quantize(toneMapping);
+    int maxDiff = 0;
+    numDiffering = 0;
+    for (size_t i = 0; i < qa.size(); i += 3) {
+        int diff = 0;
+        for (int c = 0; c < 3; ++c)
+            diff = std::max(diff, std::abs(int(qa[i + c]) - int(qb[i + c])));
+        maxDiff = std::max(maxDiff, diff);
+        numDiffering += (diff > 0);
+    }
+    return maxDiff;
+}
+
+/// Render all frames of the camera animation \c pathFile in the scene
+/// \c scenePath. The scene is read once. Frames are written to the files
+/// named by the printf pattern \c outPattern, or as a sequence of PPM images
+/// to stdout if \c outPattern is "-", in which case all messages go to stderr.
+int animate(const std::string &scenePath, const std::string &pathFile,
+            const std::string &outPattern, const RenderOptions &options) {
+    const bool toStdout = (outPattern == "-");
+    if (!toStdout && outPattern.find('%') == std::string::npos) {
+        std::cerr << "Output pattern " << outPattern << " needs a frame number, e.g. frame_%03d.png\n";
+        return 1;
+    }
+
+    // keep stdout free for the images: redirect std::cout (also used while
+    // reading the scene) to stderr, and write the images to the original buffer
+    std::streambuf *coutBuffer = std::cout.rdbuf();
+    std::ostream out(coutBuffer);
+    if (toStdout) std::cout.rdbuf(std::cerr.rdbuf());
+    std::ostream &log = std::cout;
+
+    CameraPath path(pathFile);
+    log << "Read scene '" << scenePath << "'..." << std::flush;
+    Scene s(scenePath);
+    log << "\ndone (" << s.numObjects() << " objects)\n";
+
+    const Camera camera = s.getCamera();
+    StopWatch total;
+    total.start();
+    for (unsigned int frame = 0; frame < path.num_frames(); ++frame) {
+        s.setCamera(path.camera(frame, camera));
+
+        StopWatch timer;
+        Image image = renderScene(s, options, timer, nullptr);
+
+        bool ok;
+        if (toStdout) {
+            ok = image.write_ppm(out, options.toneMapping);
+            log << "Frame " << frame + 1 << "/" << path.num_frames() << " (" << timer << ")\n";
+        }
+        else {
+            char filename[1024];
+            std::snprintf(filename, sizeof(filename), outPattern.c_str(), frame + 1);
+            ok = image.write(filename, options.toneMapping);
+            log << "Frame " << frame + 1 << "/" << path.num_frames() << " -> " << filename
+                << " (" << timer << ")\n";
+        }
+        if (!ok) {
+            std::cerr << "Cannot write frame " << frame + 1 << "\n";
+            if (toStdout) std::cout.rdbuf(coutBuffer);
+            return 1;
+        }
+    }
+    total.stop();
+    log << path.num_frames() << " frames done (" << total << ")\n";
+
+    if (toStdout) std::cout.rdbuf(coutBuffer);
+    return 0;
+}
 
 /// Program entry point.
 int main(int argc, char **argv) {
-    // Parse input scene file/output path from command line arguments
+    // Parse input scene file/output path and options from command line arguments
     struct RaytraceJob { std::string scenePath, outPath; };
     std::vector<RaytraceJob> jobs;
+    RenderOptions options;
+    TileScheduler::Settings &settings = options.settings;
+    std::string cameraPath;
+    std::string statsPath;
+    bool heatmaps = false;
+    std::string tracePath;
+    bool profile = false;
 
-    if (argc == 3)
-        jobs.emplace_back(RaytraceJob{argv[1], argv[2]});
-    else if (((argc == 2) && argv[1][0] == '0') || argc < 2) {
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        const bool hasValue = (i + 1 < argc);
+        if      (arg == "--tile"    && hasValue) settings.tile_size   = std::stoi(argv[++i]);
+        else if (arg == "--order"   && hasValue) {
+            try {
+                settings.order = TileScheduler::parse_order(argv[++i]);
+            }
+            catch (const std::runtime_error &) {
+                std::cerr << "Tile order has to be scanline, morton, or hilbert\n";
+                exit(1);
+            }
+        }
+        else if (arg == "--threads" && hasValue) settings.num_threads = std::max(0, std::stoi(argv[++i]));
+        else if (arg == "--packet"  && hasValue) options.packetSize   = std::stoi(argv[++i]);
+        else if (arg == "--animate" && hasValue) cameraPath           = argv[++i];
+        else if (arg == "--min-throughput" && hasValue) options.minThroughput = std::stod(argv[++i]);
+        else if (arg == "--precision" && hasValue) {
+            const std::string precision(argv[++i]);
+            if      (precision == "float")  options.precision = Scene::SINGLE_PRECISION;
+            else if (precision == "double") options.precision = Scene::DOUBLE_PRECISION;
+            else {
+                std::cerr << "Precision has to be float or double\n";
+                exit(1);
+            }
+        }
+        else if (arg == "--stats"   && hasValue) statsPath            = argv[++i];
+        else if (arg == "--heatmaps")            heatmaps             = true;
+        else if (arg == "--exposure" && hasValue) options.toneMapping.exposure = std::stof(argv[++i]);
+        else if (arg == "--tonemap"  && hasValue) {
+            try {
+                options.toneMapping.tone_map = Image::parse_tone_map(argv[++i]);
+            }
+            catch (const std::runtime_error &) {
+                std::cerr << "Tone map has to be clamp or reinhard\n";
+                exit(1);
+            }
+        }
+        else if (arg == "--srgb")                options.toneMapping.srgb     = true;
+        else if (arg == "--profile")             profile              = true;
+        else if (arg == "--trace"   && hasValue) tracePath            = argv[++i];
+        else if (arg == "--compare")             options.compare      = true;
+        else if (arg == "--wavefront")           options.wavefront    = true;
+        else if (arg == "--no-cache")            Mesh::cache_enabled  = false;
+        else if (arg == "--bvh-leaf-size" && hasValue) Mesh::bvh_leaf_size = std::stoi(argv[++i]);
+        else if (arg == "--bvh" && hasValue) {
+            const std::string method(argv[++i]);
+            if      (method == "fast")    Mesh::bvh_method = Scene::bvh_method = BVH::MEDIAN;
+            else if (method == "quality") Mesh::bvh_method = Scene::bvh_method = BVH::SAH;
+            else {
+                std::cerr << "BVH build has to be fast or quality\n";
+                exit(1);
+            }
+        }
+        else args.push_back(arg);
+    }
+
+    if (Mesh::bvh_leaf_size < 1) {
+        std::cerr << "BVH leaf size has to be at least 1\n";
+        exit(1);
+    }
+
+    const int packetSize = options.packetSize;
+    if (packetSize < 1 || packetSize > RayPacket::MAX_SIZE || (packetSize & (packetSize - 1))) {
+        std::cerr << "Packet size has to be 1, 2, 4, 8, or 16\n";
+        exit(1);
+    }
+
+    if (options.precision == Scene::SINGLE_PRECISION && (packetSize > 1 || options.wavefront)) {
+        std::cerr << "Packets and wavefront rendering are only available in double precision\n";
+        exit(1);
+    }
+
+    if (!cameraPath.empty()) {
+        if (args.size() != 2) {
+            std::cerr << "Usage: " << argv[0] << " [options] --animate path.cam input.sce frame_%03d.png|-\n";
+            exit(1);
+        }
+        return animate(args[0], cameraPath, args[1], options);
+    }
+
+    if (args.size() == 2)
+        jobs.emplace_back(RaytraceJob{args[0], args[1]});
+    else if (((args.size() == 1) && args[0][0] == '0') || args.empty()) {
         jobs = { {
             {"../scenes/spheres/spheres.sce",       "spheres.png"},
             {"../scenes/cylinders/cylinders.sce",   "cylinders.png"},
@@ -42,26 +252,144 @@ int main(int argc, char **argv) {
         } };
     }
     else {
-        std::cerr << "Usage: " << argv[0] << " input.sce output.png\n";
-        std::cerr << "Or: " << argv[0] << " 0\n";
+        std::cerr << "Usage: " << argv[0] << " [options] input.sce output.png|.tga|.ppm|.pfm\n";
+        std::cerr << "Or: " << argv[0] << " [options] 0\n";
+        std::cerr << "Options:\n";
+        std::cerr << "  --tile N                          tile size in pixels (default 16)\n";
+        std::cerr << "  --order scanline|morton|hilbert   tile traversal order (default hilbert)\n";
+        std::cerr << "  --threads N                       number of render threads (default: all cores)\n";
+        std::cerr << "  --packet 1|2|4|8|16               primary rays traced together (default 1)\n";
+        std::cerr << "  --animate path.cam                render all frames of a camera path, the output is a\n";
+        std::cerr << "                                    printf pattern (frame_%03d.png) or - for PPM to stdout\n";
+        std::cerr << "  --wavefront                       render in waves of rays instead of pixel by pixel\n";
+        std::cerr << "  --min-throughput W                stop tracing reflections once their weight drops below W\n";
+        std::cerr << "                                    (default 0: trace all reflections up to the scene's depth)\n";
+        std::cerr << "  --precision float|double          floating point precision of ray tracing (default double)\n";
+        std::cerr << "  --compare                         also render in double precision (scalar rays) and report\n";
+        std::cerr << "                                    the per-pixel differences of the 8-bit colors\n";
+        std::cerr << "  --no-cache                        always parse .off files, never read or write .off.cache files\n";
+        std::cerr << "  --bvh-leaf-size N                 maximum number of triangles per BVH leaf (default 4)\n";
+        std::cerr << "  --bvh fast|quality                build BVHs by median splits or by the surface area heuristic\n"
+                  << "                                    (default quality)\n";
+        std::cerr << "  --stats file.json                 count rays, box, triangle, and object tests, hits per object,\n"
+                  << "                                    and the time of every phase, and write them to file.json\n";
+        std::cerr << "  --heatmaps                        with --stats, also write the counts per pixel as images\n"
+                  << "                                    next to the output image (output_box_tests.png, ...)\n";
+        std::cerr << "  --exposure E                      multiply the colors by E before tone mapping (default 1)\n";
+        std::cerr << "  --tonemap clamp|reinhard          map colors above 1 by clamping or by c/(1+c) (default clamp)\n";
+        std::cerr << "  --srgb                            encode 8-bit colors with the sRGB curve instead of linearly\n";
+        std::cerr << "  --profile                         print the time of every part of the run (reading meshes,\n"
+                  << "                                    computing normals, building BVHs, rendering tiles, ...) as a tree\n";
+        std::cerr << "  --trace file.json                 write the timed parts of all threads as Chrome trace events\n"
+                  << "                                    (chrome://tracing, ui.perfetto.dev)\n";
         std::cerr << std::flush;
         exit(1);
     }
 
-    for (const auto &job : jobs) {
+    if (heatmaps && statsPath.empty()) {
+        std::cerr << "Heatmaps need --stats\n";
+        exit(1);
+    }
+
+    // the statistics of all jobs are written as a JSON array
+    std::ofstream statsFile;
+    if (!statsPath.empty()) {
+        statsFile.open(statsPath);
+        if (!statsFile) {
+            std::cerr << "Cannot write statistics to " << statsPath << "\n";
+            exit(1);
+        }
+        statsFile << "[";
+        Statistics::enabled = true;
+    }
+
+    Profiler::enabled = profile || !tracePath.empty();
+
+    struct Comparison { std::string scenePath; int maxDiff; size_t numDiffering, numPixels; };
+    std::vector<Comparison> comparisons;
+
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        const RaytraceJob &job = jobs[j];
+        Statistics::reset();
+        Profiler::Scope jobScope("scene " + job.scenePath);
+
         std::cout << "Read scene '" << job.scenePath << "'..." << std::flush;
-        Scene s(job.scenePath);
+        std::unique_ptr<Scene> scene;
+        {
+            Statistics::PhaseTimer phase(Statistics::PARSE);
+            scene.reset(new Scene(job.scenePath));
+        }
+        Scene &s = *scene;
         std::cout << "\ndone (" << s.numObjects() << " objects)\n";
 
+        const unsigned int width = s.getCamera().width, height = s.getCamera().height;
+        if (heatmaps) Statistics::record_pixels(width, height);
+
         StopWatch timer;
         std::cout << "Ray tracing..." << std::flush;
-        timer.start();
-        auto image = s.render();
-        timer.stop();
-        std::cout << " done (" << timer << ")\n";
+        Image image = renderScene(s, options, timer, &std::cout);
+        Statistics::stop_recording_pixels();
 
         std::cout << "Write image...";
-        image.write(job.outPath);
+        {
+            Statistics::PhaseTimer phase(Statistics::ENCODE);
+            if (!image.write(job.outPath, options.toneMapping))
+                std::cerr << "Cannot write " << job.outPath << "\n";
+        }
         std::cout << "done\n";
+
+        // the render for --compare below is not part of the statistics
+        if (Statistics::enabled) {
+            statsFile << (j ? ",\n" : "\n");
+            Statistics::write_json(statsFile, job.scenePath, width, height, Statistics::totals());
+
+            if (heatmaps) {
+                const std::string prefix = job.outPath.substr(0, job.outPath.rfind('.'));
+                if (!Statistics::write_heatmaps(prefix))
+                    std::cerr << "Cannot write heatmaps " << prefix << "_*.png\n";
+            }
+        }
+
+        if (options.compare) {
+            Profiler::Scope compareScope("compare");
+            RenderOptions reference = options;
+            reference.packetSize = 1;
+            reference.wavefront  = false;
+            reference.precision  = Scene::DOUBLE_PRECISION;
+
+            StopWatch referenceTimer;
+            std::cout << "Ray tracing in double precision for comparison..." << std::flush;
+            Image referenceImage = renderScene(s, reference, referenceTimer, nullptr);
+            std::cout << " done (" << referenceTimer << ")\n";
+
+            size_t numDiffering;
+            const int maxDiff = compareImages(image, referenceImage, options.toneMapping, numDiffering);
+            comparisons.push_back(Comparison{job.scenePath, maxDiff, numDiffering,
+                                             size_t(image.width()) * image.height()});
+        }
+    }
+
+    if (statsFile.is_open()) {
+        statsFile << "\n]\n";
+        std::cout << "Statistics written to " << statsPath << "\n";
+    }
+
+    if (profile) {
+        std::cout << "\nProfile (wall time, tiles of all threads added up):\n";
+        Profiler::write_report(std::cout);
+    }
+    if (!tracePath.empty()) {
+        if (Profiler::write_trace(tracePath))
+            std::cout << "Trace written to " << tracePath << "\n";
+        else
+            std::cerr << "Cannot write trace to " << tracePath << "\n";
+    }
+
+    if (!comparisons.empty()) {
+        std::cout << "\nDifferences to the double precision render (8-bit color channels):\n";
+        for (const Comparison &c : comparisons) {
+            std::cout << "  " << c.scenePath << ": max " << c.maxDiff << ", "
+                      << c.numDiffering << " of " << c.numPixels << " pixels differ\n";
+        }
     }
 }
@@ -0,0 +1,325 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== includes =================================================================
+
+#include "StopWatch.h"
+#include "Scene.h"
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/// The timings of one scene at one thread count.
+struct Result
+{
+    std::string scene;
+    unsigned int width, height;
+    int threads;
+    /// render times of the timed runs in ms, sorted
+    std::vector<double> times;
+    /// primary, shadow, and reflected rays of one render
+    unsigned long long rays;
+
+    double median() const
+    {
+        const size_t n = times.size();
+        return (n % 2) ? times[n / 2] : 0.5 * (times[n / 2 - 1] + times[n / 2]);
+    }
+
+    /// 95th percentile by the nearest rank
+    double p95() const
+    {
+        const size_t rank = size_t(std::ceil(0.95 * times.size()));
+        return times[std::max<size_t>(rank, 1) - 1];
+    }
+
+    /// rays per second at the median time
+    double rays_per_second() const
+    {
+        return rays / (median() * 1e-3);
+    }
+
+    /// key to match the result with a baseline
+    std::string key() const
+    {
+        std::ostringstream s;
+        s << scene << ' ' << width << 'x' << height << ' ' << threads;
+        return s.str();
+    }
+};
+
+
+/// Split the comma separated list \c _s.
+static std::vector<std::string> split(const std::string& _s)
+{
+    std::vector<std::string> fields;
+    std::istringstream in(_s);
+    std::string field;
+    while (std::getline(in, field, ','))
+        fields.push_back(field);
+    return fields;
+}
+
+
+/// Read the median times of a CSV file written by --csv, by Result::key().
+/// Returns false if the file cannot be read.
+static bool read_baseline(const std::string& _filename, std::map<std::string, double>& _medians)
+{
+    std::ifstream in(_filename);
+    std::string line;
+    if (!in || !std::getline(in, line)) return false;
+
+    // find the columns by their names
+    const std::vector<std::string> header = split(line);
+    auto column = [&](const std::string& _name)
+    {
+        return int(std::find(header.begin(), header.end(), _name) - header.begin());
+    };
+    const int scene = column("scene"), width = column("width"), height = column("height");
+    const int threads = column("threads"), median = column("median_ms");
+    const int columns = int(header.size());
+    if (std::max(std::max(scene, width), std::max(std::max(height, threads), median)) >= columns)
+        return false;
+
+    while (std::getline(in, line))
+    {
+        const std::vector<std::string> f = split(line);
+        if (int(f.size()) < columns) continue;
+
+        Result r;
+        r.scene   = f[scene];
+        r.width   = unsigned(std::stoul(f[width]));
+        r.height  = unsigned(std::stoul(f[height]));
+        r.threads = std::stoi(f[threads]);
+        _medians[r.key()] = std::stod(f[median]);
+    }
+    return true;
+}
+
+
+/// Write \c _results as CSV to \c _os.
+static void write_csv(std::ostream& _os, const std::vector<Result>& _results)
+{
+    _os << "scene,width,height,threads,runs,median_ms,p95_ms,min_ms,rays,rays_per_s\n";
+    _os << std::fixed << std::setprecision(3);
+    for (const Result& r: _results)
+        _os << r.scene << ',' << r.width << ',' << r.height << ',' << r.threads << ','
+            << r.times.size() << ',' << r.median() << ',' << r.p95() << ',' << r.times.front() << ','
+            << r.rays << ',' << std::setprecision(0) << r.rays_per_second() << std::setprecision(3) << '\n';
+}
+
+
+/// Write \c _results as a JSON array to \c _os.
+static void write_json(std::ostream& _os, const std::vector<Result>& _results)
+{
+    _os << "[" << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < _results.size(); ++i)
+    {
+        const Result& r = _results[i];
+        _os << (i ? ",\n" : "\n")
+            << "  { \"scene\": \"" << r.scene << "\", \"width\": " << r.width << ", \"height\": " << r.height
+            << ", \"threads\": " << r.threads << ", \"runs\": " << r.times.size()
+            << ", \"median_ms\": " << r.median() << ", \"p95_ms\": " << r.p95()
+            << ", \"min_ms\": " << r.times.front() << ", \"rays\": " << r.rays
+            << ", \"rays_per_s\": " << std::setprecision(0) << r.rays_per_second() << std::setprecision(3)
+            << ",\n    \"times_ms\": [";
+        for (size_t k = 0; k < r.times.size(); ++k)
+            _os << (k ? ", " : "") << r.times[k];
+        _os << "] }";
+    }
+    _os << "\n]\n";
+}
+
+
+/// Program entry point.
+int main(int argc, char **argv) {
+    // Parse the scene files and options from command line arguments
+    std::vector<std::string> files;
+    int repetitions = 5;
+    int warmup      = 1;
+    double scale    = 1.0;
+    double threshold = 10.0;
+    std::vector<int> thread_counts = { 0 };
+    std::string json_path, csv_path, baseline_path;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        const bool hasValue = (i + 1 < argc);
+        if      (arg == "--repeat"    && hasValue) repetitions   = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--warmup"    && hasValue) warmup        = std::max(0, std::stoi(argv[++i]));
+        else if (arg == "--scale"     && hasValue) scale         = std::stod(argv[++i]);
+        else if (arg == "--json"      && hasValue) json_path     = argv[++i];
+        else if (arg == "--csv"       && hasValue) csv_path      = argv[++i];
+        else if (arg == "--baseline"  && hasValue) baseline_path = argv[++i];
+        else if (arg == "--threshold" && hasValue) threshold     = std::stod(argv[++i]);
+        else if (arg == "--threads"   && hasValue) {
+            thread_counts.clear();
+            for (const std::string& n: split(argv[++i]))
+                thread_counts.push_back(std::max(0, std::stoi(n)));
+        }
+        else if (arg[0] == '-') {
+            std::cerr << "Usage: " << argv[0] << " [options] [scene.sce ...]\n";
+            std::cerr << "Without files, the bundled scenes are rendered.\n";
+            std::cerr << "Options:\n";
+            std::cerr << "  --repeat N          timed renders per scene and thread count (default 5)\n";
+            std::cerr << "  --warmup N          untimed renders before (default 1)\n";
+            std::cerr << "  --scale F           scale the image size of the scenes by F (default 1)\n";
+            std::cerr << "  --threads N,M,...   thread counts to render with, 0 is one per core (default 0)\n";
+            std::cerr << "  --json file.json    write the results as JSON\n";
+            std::cerr << "  --csv file.csv      write the results as CSV\n";
+            std::cerr << "  --baseline file.csv compare the median times to the CSV of an earlier run\n";
+            std::cerr << "  --threshold P       a scene regresses if it is more than P percent slower (default 10)\n";
+            exit(1);
+        }
+        else files.push_back(arg);
+    }
+
+    if (thread_counts.empty() || !(scale > 0.0)) {
+        std::cerr << "Thread counts and scale are invalid\n";
+        exit(1);
+    }
+
+    if (files.empty()) {
+        files = {
+            "../scenes/spheres/spheres.sce",
+            "../scenes/cylinders/cylinders.sce",
+            "../scenes/combo/combo.sce",
+            "../scenes/molecule/molecule.sce",
+            "../scenes/molecule2/molecule2.sce",
+            "../scenes/cube/cube.sce",
+            "../scenes/mask/mask.sce",
+            "../scenes/mirror/mirror.sce",
+            "../scenes/toon_faces/toon_faces.sce",
+            "../scenes/office/office.sce",
+            "../scenes/rings/rings.sce"
+        };
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baseline_path.empty() && !read_baseline(baseline_path, baseline)) {
+        std::cerr << "Cannot read baseline " << baseline_path << "\n";
+        exit(1);
+    }
+
+    std::cout << "render times of " << repetitions << " runs after " << warmup
+              << " warmup runs, times in ms\n";
+    std::cout << std::left  << std::setw(40) << "scene"
+              << std::right << std::setw(10) << "size"
+              << std::setw(8)  << "threads"
+              << std::setw(10) << "median"
+              << std::setw(10) << "p95"
+              << std::setw(12) << "Mrays/s";
+    if (!baseline.empty()) std::cout << std::setw(10) << "baseline" << std::setw(9) << "change";
+    std::cout << "\n";
+
+    std::vector<Result> results;
+    int regressions = 0;
+
+    for (const std::string& filename : files) {
+        // the scene prints progress while reading, which is not shown here
+        std::ostringstream log;
+        std::streambuf* cout_buffer = std::cout.rdbuf(log.rdbuf());
+        Scene scene(filename);
+        std::cout.rdbuf(cout_buffer);
+
+        Camera camera = scene.getCamera();
+        camera.width  = std::max(1u, unsigned(std::lround(camera.width  * scale)));
+        camera.height = std::max(1u, unsigned(std::lround(camera.height * scale)));
+        camera.init();
+        scene.setCamera(camera);
+
+        // count the rays once, since counting is not free
+        Statistics::enabled = true;
+        Statistics::reset();
+        scene.render();
+        const Statistics::Totals totals = Statistics::totals();
+        Statistics::enabled = false;
+
+        for (int threads: thread_counts) {
+            TileScheduler::Settings settings;
+            settings.num_threads = threads;
+
+            Result r;
+            r.scene   = filename;
+            r.width   = camera.width;
+            r.height  = camera.height;
+            r.threads = threads;
+            r.rays    = totals.counters[Statistics::PRIMARY_RAYS]
+                      + totals.counters[Statistics::SHADOW_RAYS]
+                      + totals.counters[Statistics::REFLECTION_RAYS];
+
+            for (int w = 0; w < warmup; ++w)
+                scene.render(settings);
+            for (int k = 0; k < repetitions; ++k) {
+                StopWatch timer;
+                timer.start();
+                scene.render(settings);
+                r.times.push_back(timer.stop());
+            }
+            std::sort(r.times.begin(), r.times.end());
+
+            std::ostringstream size;
+            size << r.width << 'x' << r.height;
+            std::cout << std::left  << std::setw(40) << filename
+                      << std::right << std::setw(10) << size.str()
+                      << std::setw(8)  << threads
+                      << std::fixed << std::setprecision(3)
+                      << std::setw(10) << r.median()
+                      << std::setw(10) << r.p95()
+                      << std::setw(12) << r.rays_per_second() * 1e-6;
+
+            auto base = baseline.find(r.key());
+            if (base != baseline.end()) {
+                const double change = 100.0 * (r.median() / base->second - 1.0);
+                const bool regressed = change > threshold;
+                regressions += regressed;
+                std::cout << std::setw(10) << base->second
+                          << std::setw(8) << std::setprecision(1) << std::showpos << change << '%'
+                          << std::noshowpos << (regressed ? "  REGRESSION" : "");
+            }
+            else if (!baseline.empty()) {
+                std::cout << std::setw(10) << "-";
+            }
+            std::cout << std::endl;
+
+            results.push_back(r);
+        }
+    }
+
+    bool ok = true;
+    if (!csv_path.empty()) {
+        std::ofstream csv(csv_path);
+        write_csv(csv, results);
+        if (!csv) { std::cerr << "Cannot write " << csv_path << "\n"; ok = false; }
+    }
+    if (!json_path.empty()) {
+        std::ofstream json(json_path);
+        write_json(json, results);
+        if (!json) { std::cerr << "Cannot write " << json_path << "\n"; ok = false; }
+    }
+
+    if (regressions) {
+        std::cout.unsetf(std::ios_base::floatfield);
+        std::cout << std::setprecision(6);
+        std::cout << regressions << " of " << results.size() << " measurements are more than "
+                  << threshold << "% slower than the baseline\n";
+        return 2;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,381 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== includes =================================================================
+
+#include "StopWatch.h"
+#include "MappedFile.h"
+#include "OffReader.h"
+#include "Ray.h"
+#include "Camera.h"
+#include "TriangleIntersection.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/// number of triangles intersected together, see Mesh::LANES
+static const int LANES = 4;
+
+
+/// The vertices of all triangles as structure of arrays, padded to a
+/// multiple of LANES with degenerate triangles, in both data layouts.
+template <class Scalar>
+struct Triangles
+{
+    /// number of triangles without padding
+    int size;
+    /// vertices i0, i1, i2 (watertight test)
+    std::vector<Scalar> v0[3], v1[3], v2[3];
+    /// v2, v2 - v0, v2 - v1, and the cross product of the latter two
+    /// (Cramer's rule)
+    std::vector<Scalar> base[3], edge1[3], edge2[3], normal[3];
+};
+
+
+/// Gather the triangles given by \c _indices in the layouts of both tests,
+/// the single precision data is rounded from the double precision data like
+/// in Mesh::build_triangle_arrays().
+template <class Scalar>
+static void build_triangles(const std::vector<vec3>& _positions, const std::vector<int>& _indices,
+                            Triangles<Scalar>& _t)
+{
+    const int n = int(_indices.size() / 3);
+    const int padded = (n + LANES - 1) / LANES * LANES;
+    _t.size = n;
+    for (int c = 0; c < 3; ++c)
+    {
+        _t.v0[c].assign(padded, 0);     _t.v1[c].assign(padded, 0);    _t.v2[c].assign(padded, 0);
+        _t.base[c].assign(padded, 0);   _t.edge1[c].assign(padded, 0); _t.edge2[c].assign(padded, 0);
+        _t.normal[c].assign(padded, 0);
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        const vec3& v0 = _positions[_indices[3*i]];
+        const vec3& v1 = _positions[_indices[3*i+1]];
+        const vec3& v2 = _positions[_indices[3*i+2]];
+        const vec3  e1 = v2 - v0;
+        const vec3  e2 = v2 - v1;
+        const vec3  nn = cross(e1, e2);
+        for (int c = 0; c < 3; ++c)
+        {
+            _t.v0[c][i] = Scalar(v0[c]);  _t.v1[c][i] = Scalar(v1[c]);  _t.v2[c][i] = Scalar(v2[c]);
+            _t.base[c][i] = Scalar(v2[c]);
+            _t.edge1[c][i] = Scalar(e1[c]);
+            _t.edge2[c][i] = Scalar(e2[c]);
+            _t.normal[c][i] = Scalar(nn[c]);
+        }
+    }
+}
+
+
+/// The Cramer's rule test Mesh::intersect_triangle_lanes() used before the
+/// watertight test, including its determinant threshold.
+template <class Scalar>
+static void intersect_cramer(const Triangles<Scalar>& _tri, const RayT<Scalar>& _ray, int _first,
+                             Scalar* _t, bool* _hit)
+{
+    const Scalar dx = _ray.direction[0], dy = _ray.direction[1], dz = _ray.direction[2];
+    const Scalar ox = _ray.origin[0],    oy = _ray.origin[1],    oz = _ray.origin[2];
+
+    const Scalar* v2x = &_tri.base[0][_first];   const Scalar* v2y = &_tri.base[1][_first];   const Scalar* v2z = &_tri.base[2][_first];
+    const Scalar* c1x = &_tri.edge1[0][_first];  const Scalar* c1y = &_tri.edge1[1][_first];  const Scalar* c1z = &_tri.edge1[2][_first];
+    const Scalar* c2x = &_tri.edge2[0][_first];  const Scalar* c2y = &_tri.edge2[1][_first];  const Scalar* c2z = &_tri.edge2[2][_first];
+    const Scalar* nx  = &_tri.normal[0][_first]; const Scalar* ny  = &_tri.normal[1][_first]; const Scalar* nz  = &_tri.normal[2][_first];
+
+    for (int k = 0; k < LANES; ++k)
+    {
+        const Scalar rx = v2x[k] - ox;
+        const Scalar ry = v2y[k] - oy;
+        const Scalar rz = v2z[k] - oz;
+
+        const Scalar det = nx[k]*dx + ny[k]*dy + nz[k]*dz;
+
+        const Scalar ax = ry*c2z[k] - rz*c2y[k], ay = rz*c2x[k] - rx*c2z[k], az = rx*c2y[k] - ry*c2x[k];
+        const Scalar bx = c1y[k]*rz - c1z[k]*ry, by = c1z[k]*rx - c1x[k]*rz, bz = c1x[k]*ry - c1y[k]*rx;
+
+        const Scalar alpha = (ax*dx + ay*dy + az*dz) / det;
+        const Scalar beta  = (bx*dx + by*dy + bz*dz) / det;
+        _t[k]   = (nx[k]*rx + ny[k]*ry + nz[k]*rz) / det;
+        _hit[k] = !(det < Scalar(1e-4) && det > Scalar(-1e-4))
+               && !(alpha<0 || beta <0 || (1-alpha-beta)<0 || _t[k]<0);
+    }
+}
+
+
+/// The watertight test of Mesh::intersect_triangle_lanes().
+template <class Scalar>
+static void intersect_watertight(const Triangles<Scalar>& _tri, const WatertightRay<Scalar>& _ray, int _first,
+                                 Scalar* _t, bool* _hit)
+{
+    const Scalar* ax = &_tri.v0[_ray.kx][_first]; const Scalar* ay = &_tri.v0[_ray.ky][_first]; const Scalar* az = &_tri.v0[_ray.kz][_first];
+    const Scalar* bx = &_tri.v1[_ray.kx][_first]; const Scalar* by = &_tri.v1[_ray.ky][_first]; const Scalar* bz = &_tri.v1[_ray.kz][_first];
+    const Scalar* cx = &_tri.v2[_ray.kx][_first]; const Scalar* cy = &_tri.v2[_ray.ky][_first]; const Scalar* cz = &_tri.v2[_ray.kz][_first];
+
+    const WatertightRay<Scalar> ray = _ray;
+    Scalar t[LANES], alpha[LANES], beta[LANES], hit[LANES];
+    for (int k = 0; k < LANES; ++k)
+    {
+        hit[k] = intersect_triangle_watertight(ray, ax[k], ay[k], az[k], bx[k], by[k], bz[k],
+                                               cx[k], cy[k], cz[k], t[k], alpha[k], beta[k]) ? Scalar(1) : Scalar(0);
+    }
+    for (int k = 0; k < LANES; ++k)
+    {
+        _t[k] = t[k]; _hit[k] = hit[k] != 0;
+    }
+}
+
+
+/// Index of the closest triangle hit by \c _ray, or -1, testing all
+/// triangles with the Cramer's rule (\c _watertight false) or the
+/// watertight test (\c _watertight true).
+template <class Scalar>
+static int closest_triangle(const Triangles<Scalar>& _tri, const RayT<Scalar>& _ray, bool _watertight)
+{
+    const WatertightRay<Scalar> ray(_ray);
+    Scalar t[LANES];
+    bool   hit[LANES];
+    Scalar tmin    = std::numeric_limits<Scalar>::infinity();
+    int    closest = -1;
+
+    for (int first = 0; first < _tri.size; first += LANES)
+    {
+        if (_watertight) intersect_watertight(_tri, ray, first, t, hit);
+        else             intersect_cramer(_tri, _ray, first, t, hit);
+
+        for (int k = 0; k < LANES && first + k < _tri.size; ++k)
+        {
+            if (hit[k] && t[k] < tmin)
+            {
+                tmin    = t[k];
+                closest = first + k;
+            }
+        }
+    }
+    return closest;
+}
+
+
+/// Run \c _func \c _repetitions times and return the fastest time in ms.
+template <class Func>
+static double best_time(int _repetitions, const Func& _func)
+{
+    double best = std::numeric_limits<double>::infinity();
+    for (int r = 0; r < _repetitions; ++r)
+    {
+        StopWatch timer;
+        timer.start();
+        _func();
+        best = std::min(best, timer.stop());
+    }
+    return best;
+}
+
+
+/// Result of one test over all rays
+struct Result
+{
+    /// fastest time in ms
+    double time;
+    /// closest triangle per ray
+    std::vector<int> closest;
+};
+
+
+/// Intersect all \c _rays with all triangles and report time and hits.
+template <class Scalar>
+static Result run(const Triangles<Scalar>& _tri, const std::vector<RayT<Scalar>>& _rays,
+                  bool _watertight, int _repetitions)
+{
+    Result result;
+    result.closest.resize(_rays.size());
+    result.time = best_time(_repetitions, [&]()
+    {
+        for (size_t i = 0; i < _rays.size(); ++i)
+            result.closest[i] = closest_triangle(_tri, _rays[i], _watertight);
+    });
+    return result;
+}
+
+
+/// Shoot rays from \c _eye through points on the inner edges of the mesh
+/// that are not silhouette edges as seen from \c _eye, i.e., the two
+/// triangles of the edge cover both sides of the point. Every such ray has
+/// to hit one of the two triangles. Return the number of rays and the
+/// number of rays that miss both for each test.
+template <class Scalar>
+static void count_leaks(const std::vector<vec3>& _positions, const std::vector<int>& _indices,
+                        const Triangles<Scalar>& _tri, const vec3& _eye,
+                        int& _rays, int& _leaks_cramer, int& _leaks_watertight)
+{
+    // the triangles of every edge
+    std::map<std::pair<int,int>, std::vector<int>> edges;
+    for (int i = 0; i < int(_indices.size() / 3); ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const int a = _indices[3*i + k], b = _indices[3*i + (k+1)%3];
+            edges[std::make_pair(std::min(a,b), std::max(a,b))].push_back(i);
+        }
+    }
+
+    _rays = _leaks_cramer = _leaks_watertight = 0;
+    for (const auto& e: edges)
+    {
+        if (e.second.size() != 2) continue;
+        const vec3& p = _positions[e.first.first];
+        const vec3& q = _positions[e.first.second];
+
+        // the opposite vertices have to lie on different sides of the plane
+        // through the eye and the edge
+        double side[2];
+        for (int j = 0; j < 2; ++j)
+        {
+            const int* t = &_indices[3 * e.second[j]];
+            int r = t[0];
+            for (int k = 0; k < 3; ++k)
+                if (t[k] != e.first.first && t[k] != e.first.second) r = t[k];
+            side[j] = dot(cross(p - _eye, q - _eye), _positions[r] - _eye);
+        }
+        if (!(side[0] * side[1] < 0)) continue;
+
+        // the two triangles, in the first two lanes
+        Triangles<Scalar> pair;
+        pair.size = 2;
+        for (int c = 0; c < 3; ++c)
+        {
+            std::vector<Scalar>* dst[] = { pair.v0, pair.v1, pair.v2, pair.base, pair.edge1, pair.edge2, pair.normal };
+            const std::vector<Scalar>* src[] = { _tri.v0, _tri.v1, _tri.v2, _tri.base, _tri.edge1, _tri.edge2, _tri.normal };
+            for (int a = 0; a < 7; ++a)
+            {
+                dst[a][c].assign(LANES, 0);
+                dst[a][c][0] = src[a][c][e.second[0]];
+                dst[a][c][1] = src[a][c][e.second[1]];
+            }
+        }
+
+        for (int s = 1; s < 8; ++s)
+        {
+            const double lambda = s / 8.0;
+            const RayT<Scalar> ray(Vec3T<Scalar>(_eye), Vec3T<Scalar>((1 - lambda) * p + lambda * q - _eye));
+            Scalar t[LANES];
+            bool   hit[LANES];
+
+            intersect_cramer(pair, ray, 0, t, hit);
+            _leaks_cramer += !(hit[0] || hit[1]);
+            intersect_watertight(pair, WatertightRay<Scalar>(ray), 0, t, hit);
+            _leaks_watertight += !(hit[0] || hit[1]);
+            ++_rays;
+        }
+    }
+}
+
+
+/// Compare both tests in precision \c Scalar and print one line per test.
+template <class Scalar>
+static void compare(const char* _precision, const std::vector<vec3>& _positions,
+                    const std::vector<int>& _indices, const Camera& _camera, int _repetitions)
+{
+    Triangles<Scalar> tri;
+    build_triangles(_positions, _indices, tri);
+
+    std::vector<RayT<Scalar>> rays;
+    for (unsigned int y = 0; y < _camera.height; ++y)
+        for (unsigned int x = 0; x < _camera.width; ++x)
+            rays.push_back(RayT<Scalar>(_camera.primary_ray(x, y)));
+
+    const Result cramer     = run(tri, rays, false, _repetitions);
+    const Result watertight = run(tri, rays, true,  _repetitions);
+
+    int hits_cramer = 0, hits_watertight = 0, different = 0;
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        hits_cramer     += (cramer.closest[i] >= 0);
+        hits_watertight += (watertight.closest[i] >= 0);
+        different       += (cramer.closest[i] != watertight.closest[i]);
+    }
+
+    int edge_rays, leaks_cramer, leaks_watertight;
+    count_leaks(_positions, _indices, tri, _camera.eye, edge_rays, leaks_cramer, leaks_watertight);
+
+    const double tests = double(rays.size()) * tri.size;
+    std::cout << std::left << std::setw(8) << _precision << std::setw(12) << "cramer"
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << cramer.time
+              << std::setw(12) << 1e6 * cramer.time / tests
+              << std::setw(8)  << hits_cramer
+              << std::setw(8)  << leaks_cramer << "\n";
+    std::cout << std::left << std::setw(8) << _precision << std::setw(12) << "watertight"
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << watertight.time
+              << std::setw(12) << 1e6 * watertight.time / tests
+              << std::setw(8)  << hits_watertight
+              << std::setw(8)  << leaks_watertight << "\n";
+    std::cout << "  " << different << " of " << rays.size() << " rays hit a different triangle, "
+              << edge_rays << " rays through inner edges\n";
+}
+
+
+/// Program entry point.
+int main(int argc, char **argv) {
+    // Parse the options and the OFF file from command line arguments
+    std::string filename = "../scenes/mask/mask.off";
+    int repetitions = 5;
+    unsigned int resolution = 128;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        const bool hasValue = (i + 1 < argc);
+        if      (arg == "--repeat"     && hasValue) repetitions = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--resolution" && hasValue) resolution  = std::max(1, std::stoi(argv[++i]));
+        else if (arg[0] == '-') {
+            std::cerr << "Usage: " << argv[0] << " [--repeat N] [--resolution N] [file.off]\n";
+            std::cerr << "Without a file, the mesh of the mask scene is read.\n";
+            exit(1);
+        }
+        else filename = arg;
+    }
+
+    MappedFile file(filename);
+    OffReader  reader;
+    if (!file.is_open() || !reader.read(file.data(), file.size())) {
+        std::cerr << "Can't read " << filename << ": " << reader.error() << "\n";
+        exit(1);
+    }
+
+    // a camera looking at the center of the mesh from a diagonal direction
+    vec3 bb_min = reader.positions()[0], bb_max = bb_min;
+    for (const vec3& p: reader.positions()) {
+        bb_min = min(bb_min, p);
+        bb_max = max(bb_max, p);
+    }
+    const vec3 center = 0.5 * (bb_min + bb_max);
+    const Camera camera(center + 2.5 * (bb_max - bb_min), center, vec3(0,1,0), 45, resolution, resolution);
+
+    std::cout << filename << ": " << reader.indices().size() / 3 << " triangles, "
+              << resolution << "x" << resolution << " primary rays against all triangles, best of "
+              << repetitions << " runs\n";
+    std::cout << std::left  << std::setw(8) << "" << std::setw(12) << "test"
+              << std::right << std::setw(10) << "ms"
+              << std::setw(12) << "ns/test"
+              << std::setw(8)  << "hits"
+              << std::setw(8)  << "leaks" << "\n";
+
+    compare<double>("double", reader.positions(), reader.indices(), camera, repetitions);
+    compare<float> ("float",  reader.positions(), reader.indices(), camera, repetitions);
+
+    return 0;
+}
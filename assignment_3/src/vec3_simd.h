@@ -0,0 +1,414 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef VEC3_SIMD_H
+#define VEC3_SIMD_H
+
+// This file is included by vec3.h if VEC3_SIMD is defined (CMake option
+// RAYTRACE_SIMD_VEC3). It specializes Vec3T for the scalar types supported
+// by the target's instruction set:
+//
+//   vec3  (double): 4 lanes in an AVX register, requires AVX2
+//   vec3f (float):  4 lanes in an SSE register
+//
+// A scalar type without SIMD support keeps the generic implementation of
+// vec3.h. The specializations have the same interface as the generic
+// class, and the functions below replace the generic ones by overloading,
+// so code using vec3 compiles unchanged.
+//
+// The fourth lane is padding. It is zero in constructed vectors and ignored
+// by all operations. Every component is computed with the same operations
+// in the same order as in the generic implementation (in particular, dot()
+// adds the products from x to z), so results are bitwise identical.
+//
+// The components are stored in the register type itself, so the compiler
+// can keep a vector in a register instead of round-tripping it through
+// memory. Heap allocated objects with vec3 members then need over-aligned
+// new, which is why src/CMakeLists.txt adds -faligned-new.
+
+//== INCLUDES =================================================================
+
+#include <immintrin.h>
+
+
+//== AVX2: double =============================================================
+
+#if defined(__AVX2__)
+
+#define VEC3_SIMD_DOUBLE
+
+/// \class Vec3T<double> vec3_simd.h
+/// vec3 stored in 4 lanes of an AVX register, see vec3_simd.h
+template <>
+class Vec3T<double>
+{
+public:
+
+    /// scalar type of the components
+    typedef double Scalar;
+
+private:
+
+    __m256d v_;
+
+public:
+
+    /// default constructor
+    Vec3T() : v_(_mm256_setzero_pd()) {}
+
+    /// construct with scalar value that is assigned to x, y, and z
+    explicit Vec3T(double _s) : v_(_mm256_setr_pd(_s,_s,_s,0.0)) {}
+
+    /// construct with x,y,z values
+    Vec3T(double _x, double _y, double _z) : v_(_mm256_setr_pd(_x,_y,_z,0.0)) {}
+
+    /// convert from a vector with another scalar type
+    template <class OtherScalar>
+    explicit Vec3T(const Vec3T<OtherScalar>& _v)
+    : v_(_mm256_setr_pd(double(_v[0]), double(_v[1]), double(_v[2]), 0.0)) {}
+
+    /// construct from the lanes of an AVX register
+    explicit Vec3T(__m256d _v) : v_(_v) {}
+
+    /// the components as an AVX register
+    __m256d simd() const { return v_; }
+
+
+    /// read/write the _i'th vector component (_i from 0 to 2)
+    double& operator[](unsigned int _i)
+    {
+        assert(_i < 3);
+        return reinterpret_cast<double*>(&v_)[_i];
+    }
+
+    /// read the _i'th vector component (_i from 0 to 2)
+    const double operator[](unsigned int _i) const
+    {
+        assert(_i < 3);
+        return reinterpret_cast<const double*>(&v_)[_i];
+    }
+
+
+    /// multiply this vector by a scalar \c s
+    Vec3T& operator*=(const double s)
+    {
+        v_ = _mm256_mul_pd(simd(), _mm256_set1_pd(s));
+        return *this;
+    }
+
+    /// divide this vector by a scalar \c s
+    Vec3T& operator/=(const double s)
+    {
+        v_ = _mm256_div_pd(simd(), _mm256_set1_pd(s));
+        return *this;
+    }
+
+    /// component-wise multiplication of this vector with vector \c v
+    Vec3T& operator*=(const Vec3T& v)
+    {
+        v_ = _mm256_mul_pd(simd(), v.simd());
+        return *this;
+    }
+
+    /// subtract vector \c v from this vector
+    Vec3T& operator-=(const Vec3T& v)
+    {
+        v_ = _mm256_sub_pd(simd(), v.simd());
+        return *this;
+    }
+
+    /// add vector \c v to this vector
+    Vec3T& operator+=(const Vec3T& v)
+    {
+        v_ = _mm256_add_pd(simd(), v.simd());
+        return *this;
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+/// unary minus: turn v into -v
+inline const Vec3T<double> operator-(const Vec3T<double>& v)
+{
+    return Vec3T<double>(_mm256_xor_pd(v.simd(), _mm256_set1_pd(-0.0)));
+}
+
+/// multiply vector \c v by scalar \c s
+inline const Vec3T<double> operator*(const double s, const Vec3T<double>& v)
+{
+    return Vec3T<double>(_mm256_mul_pd(_mm256_set1_pd(s), v.simd()));
+}
+
+/// multiply vector \c v by scalar \c s
+inline const Vec3T<double> operator*(const Vec3T<double>& v, const double s)
+{
+    return Vec3T<double>(_mm256_mul_pd(_mm256_set1_pd(s), v.simd()));
+}
+
+/// component-wise multiplication of vectors \c v0 and \c v1
+inline const Vec3T<double> operator*(const Vec3T<double>& v0, const Vec3T<double>& v1)
+{
+    return Vec3T<double>(_mm256_mul_pd(v0.simd(), v1.simd()));
+}
+
+/// divide vector \c v by scalar \c s
+inline const Vec3T<double> operator/(const Vec3T<double>& v, const double s)
+{
+    return Vec3T<double>(_mm256_div_pd(v.simd(), _mm256_set1_pd(s)));
+}
+
+/// add two vectors \c v0 and \c v1
+inline const Vec3T<double> operator+(const Vec3T<double>& v0, const Vec3T<double>& v1)
+{
+    return Vec3T<double>(_mm256_add_pd(v0.simd(), v1.simd()));
+}
+
+/// subtract vector \c v1 from vector \c v0
+inline const Vec3T<double> operator-(const Vec3T<double>& v0, const Vec3T<double>& v1)
+{
+    return Vec3T<double>(_mm256_sub_pd(v0.simd(), v1.simd()));
+}
+
+/// compute the component-wise minimum of vectors \c v0 and \c v1
+inline const Vec3T<double> min(const Vec3T<double>& v0, const Vec3T<double>& v1)
+{
+    // minpd(a, b) is (a < b) ? a : b, std::min(v0, v1) is (v1 < v0) ? v1 : v0
+    return Vec3T<double>(_mm256_min_pd(v1.simd(), v0.simd()));
+}
+
+/// compute the component-wise maximum of vectors \c v0 and \c v1
+inline const Vec3T<double> max(const Vec3T<double>& v0, const Vec3T<double>& v1)
+{
+    // maxpd(a, b) is (a > b) ? a : b, std::max(v0, v1) is (v0 < v1) ? v1 : v0
+    return Vec3T<double>(_mm256_max_pd(v1.simd(), v0.simd()));
+}
+
+/// compute the Euclidean dot product of \c v0 and \c v1
+inline const double dot(const Vec3T<double>& v0, const Vec3T<double>& v1)
+{
+    // multiply all lanes at once, then add x*x + y*y first, like the scalar version
+    const __m256d p  = _mm256_mul_pd(v0.simd(), v1.simd());
+    const __m128d xy = _mm256_castpd256_pd128(p);
+    const __m128d zw = _mm256_extractf128_pd(p, 1);
+    return _mm_cvtsd_f64(_mm_add_sd(_mm_add_sd(xy, _mm_unpackhi_pd(xy, xy)), zw));
+}
+
+/// normalize vector \c v by dividing it by its norm
+inline const Vec3T<double> normalize(const Vec3T<double>& v)
+{
+    const double n = std::sqrt(dot(v,v));
+    return (n != 0.0) ? v / n : v;
+}
+
+/// compute the cross product of \c v0 and \c v1
+inline const Vec3T<double> cross(const Vec3T<double>& v0, const Vec3T<double>& v1)
+{
+    // lanes (y,z,x) and (z,x,y) of both vectors
+    const __m256d a_yzx = _mm256_permute4x64_pd(v0.simd(), _MM_SHUFFLE(3,0,2,1));
+    const __m256d a_zxy = _mm256_permute4x64_pd(v0.simd(), _MM_SHUFFLE(3,1,0,2));
+    const __m256d b_yzx = _mm256_permute4x64_pd(v1.simd(), _MM_SHUFFLE(3,0,2,1));
+    const __m256d b_zxy = _mm256_permute4x64_pd(v1.simd(), _MM_SHUFFLE(3,1,0,2));
+    return Vec3T<double>(_mm256_sub_pd(_mm256_mul_pd(a_yzx, b_zxy),
+                                       _mm256_mul_pd(a_zxy, b_yzx)));
+}
+
+#endif // __AVX2__
+
+
+//== SSE: float ===============================================================
+
+#if defined(__SSE2__) || defined(_M_X64)
+
+#define VEC3_SIMD_FLOAT
+
+/// \class Vec3T<float> vec3_simd.h
+/// vec3f stored in 4 lanes of an SSE register, see vec3_simd.h
+template <>
+class Vec3T<float>
+{
+public:
+
+    /// scalar type of the components
+    typedef float Scalar;
+
+private:
+
+    __m128 v_;
+
+public:
+
+    /// default constructor
+    Vec3T() : v_(_mm_setzero_ps()) {}
+
+    /// construct with scalar value that is assigned to x, y, and z
+    explicit Vec3T(float _s) : v_(_mm_setr_ps(_s,_s,_s,0.0f)) {}
+
+    /// construct with x,y,z values
+    Vec3T(float _x, float _y, float _z) : v_(_mm_setr_ps(_x,_y,_z,0.0f)) {}
+
+    /// convert from a vector with another scalar type
+    template <class OtherScalar>
+    explicit Vec3T(const Vec3T<OtherScalar>& _v)
+    : v_(_mm_setr_ps(float(_v[0]), float(_v[1]), float(_v[2]), 0.0f)) {}
+
+    /// construct from the lanes of an SSE register
+    explicit Vec3T(__m128 _v) : v_(_v) {}
+
+    /// the components as an SSE register
+    __m128 simd() const { return v_; }
+
+
+    /// read/write the _i'th vector component (_i from 0 to 2)
+    float& operator[](unsigned int _i)
+    {
+        assert(_i < 3);
+        return reinterpret_cast<float*>(&v_)[_i];
+    }
+
+    /// read the _i'th vector component (_i from 0 to 2)
+    const float operator[](unsigned int _i) const
+    {
+        assert(_i < 3);
+        return reinterpret_cast<const float*>(&v_)[_i];
+    }
+
+
+    /// multiply this vector by a scalar \c s
+    Vec3T& operator*=(const float s)
+    {
+        v_ = _mm_mul_ps(simd(), _mm_set1_ps(s));
+        return *this;
+    }
+
+    /// divide this vector by a scalar \c s
+    Vec3T& operator/=(const float s)
+    {
+        v_ = _mm_div_ps(simd(), _mm_set1_ps(s));
+        return *this;
+    }
+
+    /// component-wise multiplication of this vector with vector \c v
+    Vec3T& operator*=(const Vec3T& v)
+    {
+        v_ = _mm_mul_ps(simd(), v.simd());
+        return *this;
+    }
+
+    /// subtract vector \c v from this vector
+    Vec3T& operator-=(const Vec3T& v)
+    {
+        v_ = _mm_sub_ps(simd(), v.simd());
+        return *this;
+    }
+
+    /// add vector \c v to this vector
+    Vec3T& operator+=(const Vec3T& v)
+    {
+        v_ = _mm_add_ps(simd(), v.simd());
+        return *this;
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+/// unary minus: turn v into -v
+inline const Vec3T<float> operator-(const Vec3T<float>& v)
+{
+    return Vec3T<float>(_mm_xor_ps(v.simd(), _mm_set1_ps(-0.0f)));
+}
+
+/// multiply vector \c v by scalar \c s
+inline const Vec3T<float> operator*(const float s, const Vec3T<float>& v)
+{
+    return Vec3T<float>(_mm_mul_ps(_mm_set1_ps(s), v.simd()));
+}
+
+/// multiply vector \c v by scalar \c s
+inline const Vec3T<float> operator*(const Vec3T<float>& v, const float s)
+{
+    return Vec3T<float>(_mm_mul_ps(_mm_set1_ps(s), v.simd()));
+}
+
+/// component-wise multiplication of vectors \c v0 and \c v1
+inline const Vec3T<float> operator*(const Vec3T<float>& v0, const Vec3T<float>& v1)
+{
+    return Vec3T<float>(_mm_mul_ps(v0.simd(), v1.simd()));
+}
+
+/// divide vector \c v by scalar \c s
+inline const Vec3T<float> operator/(const Vec3T<float>& v, const float s)
+{
+    return Vec3T<float>(_mm_div_ps(v.simd(), _mm_set1_ps(s)));
+}
+
+/// add two vectors \c v0 and \c v1
+inline const Vec3T<float> operator+(const Vec3T<float>& v0, const Vec3T<float>& v1)
+{
+    return Vec3T<float>(_mm_add_ps(v0.simd(), v1.simd()));
+}
+
+/// subtract vector \c v1 from vector \c v0
+inline const Vec3T<float> operator-(const Vec3T<float>& v0, const Vec3T<float>& v1)
+{
+    return Vec3T<float>(_mm_sub_ps(v0.simd(), v1.simd()));
+}
+
+/// compute the component-wise minimum of vectors \c v0 and \c v1
+inline const Vec3T<float> min(const Vec3T<float>& v0, const Vec3T<float>& v1)
+{
+    // see min() of vec3
+    return Vec3T<float>(_mm_min_ps(v1.simd(), v0.simd()));
+}
+
+/// compute the component-wise maximum of vectors \c v0 and \c v1
+inline const Vec3T<float> max(const Vec3T<float>& v0, const Vec3T<float>& v1)
+{
+    // see max() of vec3
+    return Vec3T<float>(_mm_max_ps(v1.simd(), v0.simd()));
+}
+
+/// compute the Euclidean dot product of \c v0 and \c v1
+inline const float dot(const Vec3T<float>& v0, const Vec3T<float>& v1)
+{
+    // multiply all lanes at once, then add x*x + y*y first, like the scalar version
+    const __m128 p = _mm_mul_ps(v0.simd(), v1.simd());
+    const __m128 s = _mm_add_ss(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1,1,1,1)));
+    return _mm_cvtss_f32(_mm_add_ss(s, _mm_movehl_ps(p, p)));
+}
+
+/// normalize vector \c v by dividing it by its norm
+inline const Vec3T<float> normalize(const Vec3T<float>& v)
+{
+    const float n = std::sqrt(dot(v,v));
+    return (n != 0.0f) ? v / n : v;
+}
+
+/// compute the cross product of \c v0 and \c v1
+inline const Vec3T<float> cross(const Vec3T<float>& v0, const Vec3T<float>& v1)
+{
+    // lanes (y,z,x) and (z,x,y) of both vectors
+    const __m128 a = v0.simd(), b = v1.simd();
+    const __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3,0,2,1));
+    const __m128 a_zxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3,1,0,2));
+    const __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3,0,2,1));
+    const __m128 b_zxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3,1,0,2));
+    return Vec3T<float>(_mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy), _mm_mul_ps(a_zxy, b_yzx)));
+}
+
+#endif // __SSE2__
+
+
+//=============================================================================
+#endif // VEC3_SIMD_H
+//=============================================================================